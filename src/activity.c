@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <mpi.h>
+
+/* Active region
+ * The value of a case only depends on the cases at distance at most radius at the previous step. So, if all the non zero cases
+ * of the initial matrix are in some boxes, all the non zero cases after s steps are in the same boxes grown by s * radius.
+ * Each process gives the bounding box of the non zero cases of its tile at the beginning, then every process knows without
+ * any communication which cases should be computed and which halo transfers only carry zeros.
+ */
+typedef struct activity {
+    coordinates matrix_size;
+    int radius;
+    int number_of_sources;
+    coordinates* source_offsets;
+    coordinates* source_sizes;
+} activity;
+
+//bounding box of the non zero cases of the tile, in any field, in the torus coordinates. Collective
+activity activity_init(tiling tiling, tile my_tile) {
+    activity activity;
+    int number_of_cpu = tiling.grid_size.x * tiling.grid_size.y;
+    int box[4] = {my_tile.size.x, my_tile.size.y, -1, -1};
+    int* boxes = malloc(sizeof(int) * 4 * (unsigned long) number_of_cpu);
+
+    for(int x = 0; x < my_tile.size.x; x++) {
+        for(int y = 0; y < my_tile.size.y; y++) {
+            for(int field = 0; field < my_tile.fields; field++) {
+                double value = tile_get_field(my_tile, field, x, y);
+                if(value < 0 || value > 0) {
+                    box[0] = (x < box[0]) ? x : box[0];
+                    box[1] = (y < box[1]) ? y : box[1];
+                    box[2] = (x > box[2]) ? x : box[2];
+                    box[3] = (y > box[3]) ? y : box[3];
+                }
+            }
+        }
+    }
+    MPI_Allgather(box, 4, MPI_INT, boxes, 4, MPI_INT, get_communicator());
+
+    activity.matrix_size = tiling.matrix_size;
+    activity.radius = tiling.halo;
+    activity.number_of_sources = 0;
+    activity.source_offsets = malloc(sizeof(coordinates) * (unsigned long) number_of_cpu);
+    activity.source_sizes = malloc(sizeof(coordinates) * (unsigned long) number_of_cpu);
+    for(int i = 0; i < number_of_cpu; i++) {
+        int* source = &boxes[4 * i];
+        if(source[2] >= 0) {
+            coordinates offset = tiling_tile_offset(tiling, tiling_tile_coordinates(tiling, i));
+            activity.source_offsets[activity.number_of_sources] = coordinates_init(offset.x + source[0], offset.y + source[1]);
+            activity.source_sizes[activity.number_of_sources] = coordinates_init(source[2] - source[0] + 1, source[3] - source[1] + 1);
+            activity.number_of_sources++;
+        }
+    }
+
+    free(boxes);
+    return activity;
+}
+
+void activity_destruct(activity* activity) {
+    free(activity->source_offsets);
+    free(activity->source_sizes);
+}
+
+/* Intersection on a circle of length length of the source [start, start + size) grown by growth with [first, first + count)
+ * first and count should not wrap around. The intersection is returned as its bounding interval [*low, *high).
+ */
+bool interval_intersection(int start, int size, long growth, int length, int first, int count, int* low, int* high) {
+    if(size + 2 * growth >= length) {
+        *low = first;
+        *high = first + count;
+        return true;
+    }
+
+    int grown_start = mod((int) (start - growth), length);
+    int grown_size = (int) (size + 2 * growth);
+    *low = first + count;
+    *high = first;
+    for(int shift = -length; shift <= length; shift += length) {
+        int a = (grown_start + shift > first) ? grown_start + shift : first;
+        int b = (grown_start + shift + grown_size < first + count) ? grown_start + shift + grown_size : first + count;
+        if(a < b) {
+            *low = (a < *low) ? a : *low;
+            *high = (b > *high) ? b : *high;
+        }
+    }
+    return *low < *high;
+}
+
+/* Bounding box of the cases of the rectangle which may be non zero after step steps
+ * Return false if they are all zero.
+ */
+bool activity_box(activity activity, int step, coordinates offset, coordinates size, coordinates* box_offset, coordinates* box_size) {
+    long growth = (long) step * activity.radius;
+    coordinates low = coordinates_init(offset.x + size.x, offset.y + size.y);
+    coordinates high = offset;
+
+    for(int i = 0; i < activity.number_of_sources; i++) {
+        int x_low, x_high, y_low, y_high;
+        if(interval_intersection(activity.source_offsets[i].x, activity.source_sizes[i].x, growth, activity.matrix_size.x, offset.x, size.x, &x_low, &x_high)
+           && interval_intersection(activity.source_offsets[i].y, activity.source_sizes[i].y, growth, activity.matrix_size.y, offset.y, size.y, &y_low, &y_high)) {
+            low = coordinates_init((x_low < low.x) ? x_low : low.x, (y_low < low.y) ? y_low : low.y);
+            high = coordinates_init((x_high > high.x) ? x_high : high.x, (y_high > high.y) ? y_high : high.y);
+        }
+    }
+
+    *box_offset = low;
+    *box_size = coordinates_init(high.x - low.x, high.y - low.y);
+    return box_size->x > 0 && box_size->y > 0;
+}
+
+bool activity_is_active(activity activity, int step, coordinates offset, coordinates size) {
+    coordinates box_offset, box_size;
+    return activity_box(activity, step, offset, size, &box_offset, &box_size);
+}
+
+//part of the tile to compute at the step step, in the tile coordinates
+bool activity_tile_box(activity activity, int step, tile my_tile, coordinates* first, coordinates* size) {
+    bool active = activity_box(activity, step, my_tile.offset, my_tile.size, first, size);
+    *first = coordinates_init(first->x - my_tile.offset.x, first->y - my_tile.offset.y);
+    return active;
+}
+
+/* Halo transfers needed after step steps
+ * The lines are sent by the tiles which are active, the columns, which contain the lines of the halo, by the tiles whose lines
+ * grown by the halo are active.
+ */
+bool activity_tile_is_active(activity activity, int step, tiling tiling, coordinates tile_coordinates, int halo_lines) {
+    coordinates offset = tiling_tile_offset(tiling, tile_coordinates);
+    coordinates size = tiling_tile_size(tiling, tile_coordinates);
+    offset.x -= halo_lines;
+    size.x += 2 * halo_lines;
+    if(size.x > activity.matrix_size.x) {
+        offset.x = 0;
+        size.x = activity.matrix_size.x;
+    }
+    return activity_is_active(activity, step, coordinates_init(mod(offset.x, activity.matrix_size.x), offset.y), size)
+        || (mod(offset.x, activity.matrix_size.x) + size.x > activity.matrix_size.x
+            && activity_is_active(activity, step, coordinates_init(0, offset.y), coordinates_init(mod(offset.x, activity.matrix_size.x) + size.x - activity.matrix_size.x, size.y)));
+}
+
+halo_activity activity_halo(activity activity, int step, tiling tiling, tile my_tile) {
+    halo_activity halo;
+    int h = my_tile.halo;
+    bool lines = activity_tile_is_active(activity, step, tiling, my_tile.grid_coordinates, 0);
+    bool columns = activity_tile_is_active(activity, step, tiling, my_tile.grid_coordinates, h);
+
+    halo.send[0] = lines;
+    halo.send[1] = lines;
+    halo.send[2] = columns;
+    halo.send[3] = columns;
+    halo.receive[0] = activity_tile_is_active(activity, step, tiling, tile_neighbour_coordinates(tiling, my_tile, -1, 0), 0);
+    halo.receive[1] = activity_tile_is_active(activity, step, tiling, tile_neighbour_coordinates(tiling, my_tile, 1, 0), 0);
+    halo.receive[2] = activity_tile_is_active(activity, step, tiling, tile_neighbour_coordinates(tiling, my_tile, 0, -1), h);
+    halo.receive[3] = activity_tile_is_active(activity, step, tiling, tile_neighbour_coordinates(tiling, my_tile, 0, 1), h);
+    return halo;
+}
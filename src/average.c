@@ -3,79 +3,114 @@
 #include <mpi.h>
 #include <stdbool.h>
 #include "shared.c"
+#include "tile.c"
+#include "stencil.c"
+#include "activity.c"
+#include "snapshot.c"
+#include "parser.c"
+#include "query.c"
+#include "ensemble.c"
+#include "fixed_point.c"
 
 /* Quelques structures utiles */
-typedef struct matrix {
-    coordinates size;
-    double* data;
-} matrix;
-
-matrix matrix_init(coordinates size) {
-    matrix matrix;
-    unsigned long matrix_size = (unsigned long) (size.x * size.y);
-    matrix.size = size;
-    matrix.data = malloc(sizeof(double) * matrix_size);
-    for(unsigned long i = 0; i < matrix_size; i++) {
-        matrix.data[i] = 0;
-    }
-    return matrix;
-}
-
-double matrix_get_case(matrix matrix, coordinates coord) {
-    return matrix.data[coord.x * matrix.size.y + coord.y];
-}
-
-void matrix_set_case(matrix* matrix, double value, coordinates coord) {
-    matrix->data[coord.x * matrix->size.y + coord.y] = value;
-}
-
-void matrix_destruct(matrix* matrix) {
-    free(matrix->data);
-}
-
 typedef struct environment {
     double p;
     int t;
-    matrix matrix;
+    coordinates size;
+    int fields;
 } environment;
 
 
 /* Input parsing */
-environment parse_file_header() {
+environment parse_file_header(parser* parser) {
     environment data;
-    coordinates matrix_size;
 
-    if(scanf("%d %d %lf %d", &matrix_size.y, &matrix_size.x, &data.p, &data.t) != 4) {
+    if(!parser_next_int(parser, &data.size.y) || !parser_next_int(parser, &data.size.x) || !parser_next_double(parser, &data.p) || !parser_next_int(parser, &data.t)) {
+        fprintf(stderr, "Bad header\n");
         exit(EXIT_FAILURE);
     }
-    data.matrix = matrix_init(matrix_size);
 
     return data;
 }
 
-coordinates parse_entry_until_request(environment* environment, bool update_matrix) {
-    coordinates coord;
-    int type;
-    double x;
-
-    while(scanf("%d %d %d %lf", &type, &coord.x, &coord.y, &x) == 4) {
-        switch(type) {
-            case 0:
-            case 1:
-                if(update_matrix) {
-                    matrix_set_case(&environment->matrix, x, coord);
-                }
-                break;
-            case 2:
-                return coord;
-            default:
-                fprintf(stderr, "Unknown description type %d\n", type);
+
+/* Computation of a scenario on the processes of the communicator. Collective
+ * The initial values are spread on the processes, the answers are given in the order of the requests of the process
+ * and should be freed. With -d, the computation is done in the deterministic mode, with -w its time is printed.
+ */
+double* simulate(environment environment, stencil stencil, const entry* entries, int number_of_values, coordinates* requests, int number_of_requests, int argc, char* argv[]) {
+    int my_id = get_my_id();
+    int received;
+    tiling tiling = tiling_init(environment.size, get_number_of_cpu(), stencil.radius);
+    coordinates my_tile_coordinates = tiling_tile_coordinates(tiling, my_id);
+    tile current = tile_init_with_fields(tiling, my_tile_coordinates, environment.fields);
+    tile next = tile_init_with_fields(tiling, my_tile_coordinates, environment.fields);
+    stencil_kernel kernel = stencil_kernel_init(stencil, environment.p);
+    bool deterministic = has_argument(argc, argv, "-d");
+    fixed_point fixed_point;
+
+    //send the initial values to the tiles
+    entry* values = entries_distribute(tiling, entries, number_of_values, &received);
+    for(int i = 0; i < received; i++) {
+        tile_set_field(&current, values[i].field, values[i].value, values[i].coord.x - current.offset.x, values[i].coord.y - current.offset.y);
+    }
+    free(values);
+    if(deterministic) {
+        stencil_kernel_to_fixed_point(&kernel);
+        fixed_point = fixed_point_init(kernel, current);
+        tile_round_to_fixed_point(&current, coordinates_init(0, 0), current.size, fixed_point);
+    }
+    activity activity = activity_init(tiling, current);
+
+    snapshot_writer writer = snapshot_writer_from_arguments(argc, argv, current);
+    snapshot_writer_step(&writer, current, 0);
+
+    //do computation
+    double start = MPI_Wtime();
+    for(int i = 0; i < environment.t; i++) {
+        //only the part of the tile the heat may have reached is exchanged and computed
+        coordinates first, size;
+        tile_exchange_halo_partially(&current, activity_halo(activity, i, tiling, current));
+        if(activity_tile_box(activity, i + 1, current, &first, &size)) {
+            stencil_kernel_apply_in_box(kernel, current, &next, first, size);
+            if(deterministic) {
+                tile_round_to_fixed_point(&next, first, size, fixed_point);
+            }
+        }
+
+        tile tmp = current;
+        current = next;
+        next = tmp;
+        snapshot_writer_step(&writer, current, i + 1);
+
+        if(my_id == 0 && i % 100 == 99 && get_communicator() == MPI_COMM_WORLD) {
+            printf("Iteration %d\n", i + 1);
         }
     }
 
-    return coordinates_init(-1, -1);
-}
+    double computation_time = MPI_Wtime() - start;
+    if(has_argument(argc, argv, "-w")) {
+        double slowest;
+        MPI_Reduce(&computation_time, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, get_communicator());
+        if(my_id == 0) {
+            fprintf(stderr, "Computation time: %lf s\n", slowest);
+        }
+    }
 
+    //answer the requests from the tiles
+    query_batch batch = query_batch_distribute(tiling, requests, number_of_requests);
+    query_batch_answer_from_tile(&batch, current);
+    double* answers = query_batch_collect(&batch);
+
+    query_batch_destruct(&batch);
+    snapshot_writer_destruct(&writer);
+    activity_destruct(&activity);
+    stencil_kernel_destruct(&kernel);
+    tile_destruct(&current);
+    tile_destruct(&next);
+    tiling_destruct(&tiling);
+    return answers;
+}
 
 /* Main code */
 int main(int argc, char* argv[])
@@ -84,71 +119,81 @@ int main(int argc, char* argv[])
 
     int my_id = get_my_id();
     environment environment;
-    double my_value;
-    int number_of_cpu = get_number_of_cpu();
-    coordinates target, my_coordinates;
-
-    if(my_id == 0) {
-        environment = parse_file_header();
-        if(number_of_cpu != environment.matrix.size.x * environment.matrix.size.y) {
-            fprintf(stderr, "The number of CPU is different than the size of the matrix.\n");
-            exit(EXIT_FAILURE);
-        }
-        target = parse_entry_until_request(&environment, true);
+    stencil stencil = stencil_from_arguments(argc, argv);
+    parser parser = parser_from_arguments(argc, argv);
+
+    if(my_id == 0 || parser_is_mapped(parser)) {
+        environment = parse_file_header(&parser);
     }
 
     MPI_Bcast(&environment.p, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
     MPI_Bcast(&environment.t, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&environment.matrix.size.x, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&environment.matrix.size.y, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    my_coordinates = get_my_cell_coordinates(environment.matrix.size);
-
-    //broadcast all data to process
-    MPI_Scatter(environment.matrix.data, 1, MPI_DOUBLE, &my_value, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-
-    //do computation
-    for(int i = 0; i < environment.t; i++) {
-        double b, d, f, h;
-
-        b = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x - 1, my_coordinates.y, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x + 1, my_coordinates.y, environment.matrix.size),
-                        my_value
-                        );
-        d = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y - 1, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y + 1, environment.matrix.size),
-                        my_value
-                        );
-        f = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y + 1, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y - 1, environment.matrix.size),
-                        my_value
-                        );
-        h = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x + 1, my_coordinates.y, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x - 1, my_coordinates.y, environment.matrix.size),
-                        my_value
-                        );
-
-        my_value = (1 - environment.p) * my_value + environment.p * (b + d + f + h) / 4;
-
-        if(my_id == 0 && i % 100 == 99) {
-            printf("Iteration %d\n", i + 1);
+    MPI_Bcast(&environment.size.x, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&environment.size.y, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    //-k gives the number of fields computed together, all with the same p
+    const char* fields_argument = get_argument_value(argc, argv, "-k");
+    environment.fields = (fields_argument == NULL) ? 1 : atoi(fields_argument);
+    if(environment.fields <= 0) {
+        if(my_id == 0) {
+            fprintf(stderr, "The number of fields should be positive.\n");
         }
+        exit(EXIT_FAILURE);
     }
 
-    //retrieve back all data
-    MPI_Gather(&my_value, 1, MPI_DOUBLE, environment.matrix.data, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    //read the entries, in parallel with -i
+    int number_of_entries, number_of_values, number_of_requests;
+    coordinates* requests;
+    parser_split(&parser);
+    entry* entries = parse_entries_with_fields(&parser, environment.fields, &number_of_entries);
+    parser_destruct(&parser);
+    number_of_values = entries_split_requests(entries, number_of_entries, &requests, &number_of_requests);
+
+    ensemble ensemble = ensemble_from_arguments(argc, argv);
+    if(!ensemble_is_enabled(ensemble)) {
+        double* answers = simulate(environment, stencil, entries, number_of_values, requests, number_of_requests, argc, argv);
+        query_print_answers(requests, answers, number_of_requests, environment.fields);
+        free(answers);
+    } else {
+        if(get_argument_value(argc, argv, "-o") != NULL) {
+            if(my_id == 0) {
+                fprintf(stderr, "Snapshots are not available with -e.\n");
+            }
+            exit(EXIT_FAILURE);
+        }
+
+        //every group gets the input, then runs its scenarios
+        entry* group_entries = ensemble_share(ensemble, entries, number_of_values, (int) sizeof(entry), &number_of_values);
+        coordinates* group_requests = ensemble_share(ensemble, requests, number_of_requests, (int) sizeof(coordinates), &number_of_requests);
+        char** texts = calloc((unsigned long) ensemble.number_of_scenarios, sizeof(char*));
+        long* lengths = calloc((unsigned long) ensemble.number_of_scenarios, sizeof(long));
+
+        set_communicator(ensemble.communicator);
+        for(int i = 0; i < ensemble.number_of_scenarios; i++) {
+            if(ensemble.group_of_scenario[i] == ensemble.my_group) {
+                environment.p = ensemble.scenarios[i].p;
+                environment.t = ensemble.scenarios[i].t;
+                double* answers = simulate(environment, stencil, group_entries, number_of_values, group_requests, number_of_requests, argc, argv);
+                texts[i] = query_format_answers(group_requests, answers, number_of_requests, environment.fields, &lengths[i]);
+                free(answers);
+            }
+        }
+        set_communicator(MPI_COMM_WORLD);
+        ensemble_print(ensemble, (get_my_id() == ensemble.group_first_cpu[ensemble.my_group]) ? texts : NULL, lengths);
 
-    if(my_id == 0) {
-        coordinates end_target = coordinates_init(-1, -1);
-        while(!coordinates_equals(target, end_target)) {
-            printf("Value of case (%d, %d) is %lf.\n", target.x, target.y, matrix_get_case(environment.matrix, target));
-            target = parse_entry_until_request(&environment, false);
-        };
+        for(int i = 0; i < ensemble.number_of_scenarios; i++) {
+            free(texts[i]);
+        }
+        free(texts);
+        free(lengths);
+        free(group_entries);
+        free(group_requests);
     }
 
+    free(entries);
+    free(requests);
+    ensemble_destruct(&ensemble);
+
     MPI_Finalize();
     return EXIT_SUCCESS;
 }
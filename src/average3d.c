@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+#include <stdbool.h>
+#include "shared.c"
+#include "tile.c"
+#include "tile3d.c"
+#include "parser.c"
+
+/* Quelques structures utiles */
+typedef struct matrix {
+    coordinates3d size;
+    double* data;
+} matrix;
+
+matrix matrix_init(coordinates3d size) {
+    matrix matrix;
+    unsigned long matrix_size = (unsigned long) size.x * (unsigned long) size.y * (unsigned long) size.z;
+    matrix.size = size;
+    matrix.data = malloc(sizeof(double) * matrix_size);
+    for(unsigned long i = 0; i < matrix_size; i++) {
+        matrix.data[i] = 0;
+    }
+    return matrix;
+}
+
+double matrix_get_case(matrix matrix, coordinates3d coord) {
+    return matrix.data[((long) coord.x * matrix.size.y + coord.y) * matrix.size.z + coord.z];
+}
+
+void matrix_set_case(matrix* matrix, double value, coordinates3d coord) {
+    matrix->data[((long) coord.x * matrix->size.y + coord.y) * matrix->size.z + coord.z] = value;
+}
+
+void matrix_destruct(matrix* matrix) {
+    free(matrix->data);
+}
+
+typedef struct environment {
+    double p;
+    int t;
+    matrix matrix;
+} environment;
+
+
+/* Input parsing
+ * Same format as the 2D one with a third coordinate: the header is "size.z size.y size.x p t"
+ * and the entries are "type x y z value". The input is read by the process 0 with the tokenizer of parser.c.
+ */
+environment parse_file_header(parser* parser) {
+    environment data;
+    coordinates3d matrix_size;
+
+    if(!parser_next_int(parser, &matrix_size.z) || !parser_next_int(parser, &matrix_size.y) || !parser_next_int(parser, &matrix_size.x)
+       || !parser_next_double(parser, &data.p) || !parser_next_int(parser, &data.t)) {
+        fprintf(stderr, "Bad header\n");
+        exit(EXIT_FAILURE);
+    }
+    data.matrix = matrix_init(matrix_size);
+
+    return data;
+}
+
+//Return false at the end of the input
+bool parser_next_entry3d(parser* parser, int* type, coordinates3d* coord, double* value) {
+    while(parser_skip_spaces(parser)) {
+        int numbers[4] = {0, 0, 0, 0};
+        long line = parser->line;
+        bool valid = parser_read_ints(parser, numbers, 4) && parser_skip_blanks(parser) && parser_read_double(parser, value)
+                  && !parser_skip_blanks(parser);
+
+        if(valid && numbers[0] >= 0 && numbers[0] <= 2) {
+            *type = numbers[0];
+            *coord = coordinates3d_init(numbers[1], numbers[2], numbers[3]);
+            return true;
+        }
+        parser_reject_line(parser, line, valid, numbers[0]);
+    }
+
+    return false;
+}
+
+/* Initial values, which are before the first request, and requests
+ * The requests are returned with their number and should be freed.
+ */
+coordinates3d* parse_entries3d(parser* parser, environment* environment, int* number_of_requests) {
+    int capacity = 1024;
+    coordinates3d* requests = malloc(sizeof(coordinates3d) * (unsigned long) capacity);
+    coordinates3d coord;
+    int type;
+    double value;
+
+    *number_of_requests = 0;
+    while(parser_next_entry3d(parser, &type, &coord, &value)) {
+        if(type == 2) {
+            if(*number_of_requests == capacity) {
+                capacity *= 2;
+                requests = realloc(requests, sizeof(coordinates3d) * (unsigned long) capacity);
+            }
+            requests[(*number_of_requests)++] = coord;
+        } else if(*number_of_requests == 0) {
+            matrix_set_case(&environment->matrix, value, coord);
+        }
+    }
+
+    return requests;
+}
+
+
+/* 7 points stencil: (1 - p) x + p * (mean of the 6 neighbours) */
+void apply_stencil(double p, tile3d from, tile3d* to) {
+    coordinates3d padded_size = tile3d_padded_size(from);
+    long shifts[3] = {(long) padded_size.y * padded_size.z, padded_size.z, 1};
+
+    for(int x = 0; x < to->size.x; x++) {
+        for(int y = 0; y < to->size.y; y++) {
+            const double* in = &from.data[tile3d_index(from, x, y, 0)];
+            double* out = &to->data[tile3d_index(*to, x, y, 0)];
+            for(int z = 0; z < to->size.z; z++) {
+                double neighbours = in[z - shifts[0]] + in[z + shifts[0]]
+                                  + in[z - shifts[1]] + in[z + shifts[1]]
+                                  + in[z - shifts[2]] + in[z + shifts[2]];
+                out[z] = (1 - p) * in[z] + p * neighbours / 6;
+            }
+        }
+    }
+}
+
+
+/* Main code */
+int main(int argc, char* argv[])
+{
+    MPI_Init(&argc, &argv);
+
+    int my_id = get_my_id();
+    environment environment;
+    int number_of_cpu = get_number_of_cpu();
+    coordinates3d* requests = NULL;
+    int number_of_requests = 0;
+
+    parser parser = parser_from_arguments(argc, argv);
+    if(my_id == 0) {
+        environment = parse_file_header(&parser);
+        requests = parse_entries3d(&parser, &environment, &number_of_requests);
+    }
+    parser_destruct(&parser);
+
+    MPI_Bcast(&environment.p, 1, MPI_DOUBLE, 0, get_communicator());
+    MPI_Bcast(&environment.t, 1, MPI_INT, 0, get_communicator());
+    MPI_Bcast(&environment.matrix.size.x, 1, MPI_INT, 0, get_communicator());
+    MPI_Bcast(&environment.matrix.size.y, 1, MPI_INT, 0, get_communicator());
+    MPI_Bcast(&environment.matrix.size.z, 1, MPI_INT, 0, get_communicator());
+
+    tiling3d tiling = tiling3d_init(environment.matrix.size, number_of_cpu, 1);
+    coordinates3d my_tile_coordinates = tiling3d_tile_coordinates(tiling, my_id);
+    tile3d current = tile3d_init(tiling, my_tile_coordinates);
+    tile3d next = tile3d_init(tiling, my_tile_coordinates);
+
+    //broadcast all data to process
+    tiling3d_scatter(tiling, environment.matrix.data, &current);
+
+    //do computation
+    for(int i = 0; i < environment.t; i++) {
+        tile3d_exchange_halo(tiling, &current);
+        apply_stencil(environment.p, current, &next);
+
+        tile3d tmp = current;
+        current = next;
+        next = tmp;
+
+        if(my_id == 0 && i % 100 == 99) {
+            printf("Iteration %d\n", i + 1);
+        }
+    }
+
+    //retrieve back all data
+    tiling3d_gather(tiling, current, environment.matrix.data);
+
+    if(my_id == 0) {
+        for(int i = 0; i < number_of_requests; i++) {
+            printf("Value of case (%d, %d, %d) is %lf.\n", requests[i].x, requests[i].y, requests[i].z, matrix_get_case(environment.matrix, requests[i]));
+        }
+        matrix_destruct(&environment.matrix);
+        free(requests);
+    }
+
+    tile3d_destruct(&current);
+    tile3d_destruct(&next);
+    tiling3d_destruct(&tiling);
+
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
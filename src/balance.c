@@ -0,0 +1,38 @@
+#include <stdlib.h>
+#include <mpi.h>
+
+/* Load balancing of the tiles
+ * A case to compute costs 1 and a thermal reservoir BALANCE_CONSTANT_COST. When the computation time of the processes is known,
+ * the costs of the cases of a process are scaled by its time per unit of cost, so the slow processes get smaller tiles.
+ * The lines and the columns of the torus are then cut in weighted strips.
+ */
+#define BALANCE_CONSTANT_COST 0.1
+
+//tiling balanced with the cases of the tiles, fixed is not zero for the thermal reservoirs. time < 0 means no timing. Collective
+tiling balance_tiling(tiling tiling, tile fixed, double time) {
+    double* line_costs = calloc((unsigned long) tiling.matrix_size.x, sizeof(double));
+    double* column_costs = calloc((unsigned long) tiling.matrix_size.y, sizeof(double));
+    double work = 0;
+
+    for(int x = 0; x < fixed.size.x; x++) {
+        for(int y = 0; y < fixed.size.y; y++) {
+            work += (tile_get_case(fixed, x, y) > 0) ? BALANCE_CONSTANT_COST : 1;
+        }
+    }
+    double scale = (time >= 0 && work > 0) ? time / work : 1;
+
+    for(int x = 0; x < fixed.size.x; x++) {
+        for(int y = 0; y < fixed.size.y; y++) {
+            double cost = scale * ((tile_get_case(fixed, x, y) > 0) ? BALANCE_CONSTANT_COST : 1);
+            line_costs[fixed.offset.x + x] += cost;
+            column_costs[fixed.offset.y + y] += cost;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, line_costs, tiling.matrix_size.x, MPI_DOUBLE, MPI_SUM, get_communicator());
+    MPI_Allreduce(MPI_IN_PLACE, column_costs, tiling.matrix_size.y, MPI_DOUBLE, MPI_SUM, get_communicator());
+
+    struct tiling balanced = tiling_from_costs(tiling, line_costs, column_costs);
+    free(line_costs);
+    free(column_costs);
+    return balanced;
+}
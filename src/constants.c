@@ -5,6 +5,13 @@
 #include <stdbool.h>
 #include "shared.c"
 #include "gfx.c"
+#include "tile.c"
+#include "stencil.c"
+#include "activity.c"
+#include "balance.c"
+#include "parser.c"
+#include "query.c"
+#include "ensemble.c"
 
 /*devil
  #define while if1
@@ -100,40 +107,126 @@ void gui_open(environment environment) {
 }
 
 /* Input parsing */
-environment parse_file_header() {
+environment parse_file_header(parser* parser) {
     environment data;
     coordinates matrix_size;
 
-    if(scanf("%d %d %lf %d", &matrix_size.y, &matrix_size.x, &data.p, &data.t) != 4) {
+    if(!parser_next_int(parser, &matrix_size.y) || !parser_next_int(parser, &matrix_size.x) || !parser_next_double(parser, &data.p) || !parser_next_int(parser, &data.t)) {
+        fprintf(stderr, "Bad header\n");
         exit(EXIT_FAILURE);
     }
-    data.matrix = matrix_init(matrix_size);
+    data.matrix.size = matrix_size;
+    data.matrix.data = NULL;
 
     return data;
 }
 
-coordinates parse_entry_until_request(environment* environment, bool update_matrix) {
-    coordinates coord;
-    int type;
-    double x;
-
-    while(scanf("%d %d %d %lf", &type, &coord.x, &coord.y, &x) == 4) {
-        switch(type) {
-            case 0:
-            case 1:
-                if(update_matrix) {
-                    matrix_set_case(&environment->matrix, matrix_case_init((case_type) type, x), coord);
-                }
-                break;
-            case 2:
-                return coord;
-            default:
-                fprintf(stderr, "Unknown description type %d\n", type);
+/* Load balancing
+ * The tiles are moved to the balanced tiling. time < 0 means no timing. Collective
+ */
+void balance(tiling* tiling, tile* current, tile* next, tile* fixed, double time) {
+    struct tiling balanced = balance_tiling(*tiling, *fixed, time);
+
+    if(tiling_same_bounds(*tiling, balanced)) {
+        tiling_destruct(&balanced);
+        return;
+    }
+
+    tile_migrate(*tiling, balanced, current);
+    tile_migrate(*tiling, balanced, fixed);
+    tile_destruct(next);
+    *next = tile_init(balanced, current->grid_coordinates);
+    tiling_destruct(tiling);
+    *tiling = balanced;
+}
+
+/* Computation of a scenario on the processes of the communicator. Collective
+ * The initial values are spread on the processes, the answers are given in the order of the requests of the process
+ * and should be freed.
+ */
+double* simulate(environment environment, stencil stencil, const entry* entries, int number_of_values, coordinates* requests, int number_of_requests, int argc, char* argv[]) {
+    int my_id = get_my_id();
+    int received;
+    const char* balance_period_argument = get_argument_value(argc, argv, "-b");
+    int balance_period = (balance_period_argument == NULL) ? 0 : atoi(balance_period_argument);
+    tiling tiling = tiling_init(environment.matrix.size, get_number_of_cpu(), stencil.radius);
+    coordinates my_tile_coordinates = tiling_tile_coordinates(tiling, my_id);
+    tile current = tile_init(tiling, my_tile_coordinates);
+    tile next = tile_init(tiling, my_tile_coordinates);
+    tile fixed = tile_init(tiling, my_tile_coordinates);
+    stencil_kernel kernel = stencil_kernel_init(stencil, environment.p);
+
+    //send the initial values to the tiles
+    entry* values = entries_distribute(tiling, entries, number_of_values, &received);
+    for(int i = 0; i < received; i++) {
+        coordinates coord = coordinates_init(values[i].coord.x - current.offset.x, values[i].coord.y - current.offset.y);
+        tile_set_case(&current, values[i].value, coord.x, coord.y);
+        tile_set_case(&fixed, (values[i].type == CONSTANT) ? 1 : 0, coord.x, coord.y);
+    }
+    free(values);
+
+    //the thermal reservoirs are almost free: balance the tiles with the number of cases to compute
+    balance(&tiling, &current, &next, &fixed, -1);
+    activity activity = activity_init(tiling, current);
+
+    //do computation
+    double computation_time = 0;
+    for(int i = 0; i < environment.t; i++) {
+        //only the part of the tile the heat may have reached is exchanged and computed
+        coordinates first, size;
+        tile_exchange_halo_partially(&current, activity_halo(activity, i, tiling, current));
+        double start = MPI_Wtime();
+        if(activity_tile_box(activity, i + 1, current, &first, &size)) {
+            stencil_kernel_apply_with_constants_in_box(kernel, current, fixed, &next, first, size);
+        }
+        computation_time += MPI_Wtime() - start;
+
+        tile tmp = current;
+        current = next;
+        next = tmp;
+
+        //balance again with the measured times, useful with heterogeneous processes
+        if(balance_period > 0 && (i + 1) % balance_period == 0 && i + 1 < environment.t) {
+            balance(&tiling, &current, &next, &fixed, computation_time);
+            computation_time = 0;
         }
 
+        if(my_id == 0 && i % 100 == 99 && get_communicator() == MPI_COMM_WORLD) {
+            printf("Iteration %d\n", i + 1);
+        }
+    }
+
+    //retrieve back all data for the graphic interface
+    if(with_gui(argc, argv)) {
+        double* matrix_values = NULL;
+        if(my_id == 0) {
+            environment.matrix = matrix_init(environment.matrix.size);
+            matrix_values = malloc(sizeof(double) * (unsigned long) (environment.matrix.size.x * environment.matrix.size.y));
+        }
+        tiling_gather(tiling, current, matrix_values);
+        if(my_id == 0) {
+            for(int i = 0; i < environment.matrix.size.x * environment.matrix.size.y; i++) {
+                environment.matrix.data[i].value = matrix_values[i];
+            }
+            gui_open(environment);
+            free(matrix_values);
+            matrix_destruct(&environment.matrix);
+        }
     }
 
-    return coordinates_init(-1, -1);
+    //answer the requests from the tiles
+    query_batch batch = query_batch_distribute(tiling, requests, number_of_requests);
+    query_batch_answer_from_tile(&batch, current);
+    double* answers = query_batch_collect(&batch);
+
+    query_batch_destruct(&batch);
+    activity_destruct(&activity);
+    stencil_kernel_destruct(&kernel);
+    tile_destruct(&current);
+    tile_destruct(&next);
+    tile_destruct(&fixed);
+    tiling_destruct(&tiling);
+    return answers;
 }
 
 /* Main code */
@@ -143,88 +236,70 @@ int main(int argc, char* argv[])
 
     int my_id = get_my_id();
     environment environment;
-    matrix_case my_value;
-    int number_of_cpu = get_number_of_cpu();
-    coordinates target, my_coordinates;
-
-    if(my_id == 0) {
-        environment = parse_file_header();
-        if(number_of_cpu != environment.matrix.size.x * environment.matrix.size.y) {
-            fprintf(stderr, "The number of CPU is different than the size of the matrix.\n");
-            exit(EXIT_FAILURE);
-        }
-        target = parse_entry_until_request(&environment, true);
+    stencil stencil = stencil_from_arguments(argc, argv);
+    parser parser = parser_from_arguments(argc, argv);
+
+    if(my_id == 0 || parser_is_mapped(parser)) {
+        environment = parse_file_header(&parser);
     }
 
     MPI_Bcast(&environment.p, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
     MPI_Bcast(&environment.t, 1, MPI_INT, 0, MPI_COMM_WORLD);
     MPI_Bcast(&environment.matrix.size.x, 1, MPI_INT, 0, MPI_COMM_WORLD);
     MPI_Bcast(&environment.matrix.size.y, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    my_coordinates = get_my_cell_coordinates(environment.matrix.size);
 
-    //broadcast all data to process
-    if(my_id == 0) {
-        for(int i = 0; i < number_of_cpu; i++) {
-            MPI_Send(&environment.matrix.data[i].case_type, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
-            MPI_Send(&environment.matrix.data[i].value, 1, MPI_DOUBLE, i, 0, MPI_COMM_WORLD);
-        }
-    }
-    MPI_Recv(&my_value.case_type, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    MPI_Recv(&my_value.value, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-    //do computation
-    for(int i = 0; i < environment.t; i++) {
-        double b, d, f, h;
-
-        b = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x - 1, my_coordinates.y, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x + 1, my_coordinates.y, environment.matrix.size),
-                        my_value.value
-                        );
-        d = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y - 1, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y + 1, environment.matrix.size),
-                        my_value.value
-                        );
-        f = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y + 1, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y - 1, environment.matrix.size),
-                        my_value.value
-                        );
-        h = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x + 1, my_coordinates.y, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x - 1, my_coordinates.y, environment.matrix.size),
-                        my_value.value
-                        );
-
-        if(my_value.case_type == VALUE) {
-            my_value.value = (1 - environment.p) * my_value.value + environment.p * (b + d + f + h) / 4;
+    //read the entries, in parallel with -i
+    int number_of_entries, number_of_values, number_of_requests;
+    coordinates* requests;
+    parser_split(&parser);
+    entry* entries = parse_entries(&parser, &number_of_entries);
+    parser_destruct(&parser);
+    number_of_values = entries_split_requests(entries, number_of_entries, &requests, &number_of_requests);
+
+    ensemble ensemble = ensemble_from_arguments(argc, argv);
+    if(!ensemble_is_enabled(ensemble)) {
+        double* answers = simulate(environment, stencil, entries, number_of_values, requests, number_of_requests, argc, argv);
+        query_print_answers(requests, answers, number_of_requests, 1);
+        free(answers);
+    } else {
+        if(with_gui(argc, argv)) {
+            if(my_id == 0) {
+                fprintf(stderr, "The graphic interface is not available with -e.\n");
+            }
+            exit(EXIT_FAILURE);
         }
 
-        if(my_id == 0 && i % 100 == 99) {
-            printf("Iteration %d\n", i + 1);
+        //every group gets the input, then runs its scenarios
+        entry* group_entries = ensemble_share(ensemble, entries, number_of_values, (int) sizeof(entry), &number_of_values);
+        coordinates* group_requests = ensemble_share(ensemble, requests, number_of_requests, (int) sizeof(coordinates), &number_of_requests);
+        char** texts = calloc((unsigned long) ensemble.number_of_scenarios, sizeof(char*));
+        long* lengths = calloc((unsigned long) ensemble.number_of_scenarios, sizeof(long));
+
+        set_communicator(ensemble.communicator);
+        for(int i = 0; i < ensemble.number_of_scenarios; i++) {
+            if(ensemble.group_of_scenario[i] == ensemble.my_group) {
+                environment.p = ensemble.scenarios[i].p;
+                environment.t = ensemble.scenarios[i].t;
+                double* answers = simulate(environment, stencil, group_entries, number_of_values, group_requests, number_of_requests, argc, argv);
+                texts[i] = query_format_answers(group_requests, answers, number_of_requests, 1, &lengths[i]);
+                free(answers);
+            }
         }
-    }
+        set_communicator(MPI_COMM_WORLD);
+        ensemble_print(ensemble, (get_my_id() == ensemble.group_first_cpu[ensemble.my_group]) ? texts : NULL, lengths);
 
-    //retrieve back all data
-    MPI_Send(&my_value.value, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
-    if(my_id == 0) {
-        for(int i = 0; i < number_of_cpu; i++) {
-            MPI_Recv(&environment.matrix.data[i].value, 1, MPI_DOUBLE, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        for(int i = 0; i < ensemble.number_of_scenarios; i++) {
+            free(texts[i]);
         }
+        free(texts);
+        free(lengths);
+        free(group_entries);
+        free(group_requests);
     }
 
-    if(my_id == 0) {
-        if(with_gui(argc, argv)) {
-            gui_open(environment);
-        }
-
-        coordinates end_target = coordinates_init(-1, -1);
-        while(!coordinates_equals(target, end_target)) {
-            printf("Value of case (%d, %d) is %lf.\n", target.x, target.y, matrix_get_case(environment.matrix, target).value);
-            target = parse_entry_until_request(&environment, false);
-        };
-    }
+    free(entries);
+    free(requests);
+    ensemble_destruct(&ensemble);
 
     MPI_Finalize();
     return EXIT_SUCCESS;
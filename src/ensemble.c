@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <mpi.h>
+
+/* Ensemble of scenarios
+ * With -e file, the job runs all the scenarios of the file, one "p t" per line, on the same input.
+ * The processes are split in groups with MPI_Comm_split, each group runs some of the scenarios one after the other:
+ * the longest scenarios are given first to the least loaded groups. The input is parsed once by all the processes
+ * and the results of the scenarios are printed by the process 0 in the order of the file.
+ */
+typedef struct scenario {
+    double p;
+    int t;
+} scenario;
+
+typedef struct ensemble {
+    int number_of_scenarios;
+    scenario* scenarios;
+    int number_of_groups;
+    int* group_of_scenario;
+    int* group_first_cpu;      //first process of each group in MPI_COMM_WORLD, and the number of processes at the end
+    int my_group;
+    MPI_Comm communicator;
+} ensemble;
+
+//cost of a scenario: the matrix is the same for all of them
+double scenario_cost(scenario scenario) {
+    return scenario.t + 1;
+}
+
+//groups of consecutive processes, the scenarios are given with the longest processing time first rule
+void ensemble_make_groups(ensemble* ensemble, int number_of_cpu) {
+    int number_of_groups = (ensemble->number_of_scenarios < number_of_cpu) ? ensemble->number_of_scenarios : number_of_cpu;
+    double* loads = calloc((unsigned long) number_of_groups, sizeof(double));
+    bool* assigned = calloc((unsigned long) ensemble->number_of_scenarios, sizeof(bool));
+
+    ensemble->number_of_groups = number_of_groups;
+    ensemble->group_first_cpu = malloc(sizeof(int) * (unsigned long) (number_of_groups + 1));
+    for(int g = 0; g <= number_of_groups; g++) {
+        ensemble->group_first_cpu[g] = g * (number_of_cpu / number_of_groups) + ((g < number_of_cpu % number_of_groups) ? g : number_of_cpu % number_of_groups);
+    }
+
+    ensemble->group_of_scenario = malloc(sizeof(int) * (unsigned long) ensemble->number_of_scenarios);
+    for(int i = 0; i < ensemble->number_of_scenarios; i++) {
+        int longest = -1;
+        for(int j = 0; j < ensemble->number_of_scenarios; j++) {
+            if(!assigned[j] && (longest < 0 || scenario_cost(ensemble->scenarios[j]) > scenario_cost(ensemble->scenarios[longest]))) {
+                longest = j;
+            }
+        }
+        int best_group = 0;
+        double best_load = 0;
+        for(int g = 0; g < number_of_groups; g++) {
+            int size = ensemble->group_first_cpu[g + 1] - ensemble->group_first_cpu[g];
+            double load = (loads[g] + scenario_cost(ensemble->scenarios[longest])) / size;
+            if(g == 0 || load < best_load) {
+                best_group = g;
+                best_load = load;
+            }
+        }
+        assigned[longest] = true;
+        loads[best_group] += scenario_cost(ensemble->scenarios[longest]);
+        ensemble->group_of_scenario[longest] = best_group;
+    }
+
+    free(loads);
+    free(assigned);
+}
+
+//the scenarios are given by -e file, without it the ensemble is disabled. Collective on MPI_COMM_WORLD
+ensemble ensemble_from_arguments(int argc, char* argv[]) {
+    ensemble ensemble;
+    const char* name = get_argument_value(argc, argv, "-e");
+    int my_id, number_of_cpu;
+
+    ensemble.number_of_scenarios = 0;
+    ensemble.scenarios = NULL;
+    ensemble.communicator = MPI_COMM_NULL;
+    if(name == NULL) {
+        return ensemble;
+    }
+
+    //the file is small, every process reads it
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
+    MPI_Comm_size(MPI_COMM_WORLD, &number_of_cpu);
+    parser parser = parser_from_file(name);
+    int capacity = 16;
+    ensemble.scenarios = malloc(sizeof(scenario) * (unsigned long) capacity);
+    while(parser_next_double(&parser, &ensemble.scenarios[ensemble.number_of_scenarios].p)) {
+        if(!parser_next_int(&parser, &ensemble.scenarios[ensemble.number_of_scenarios].t) || ensemble.scenarios[ensemble.number_of_scenarios].t < 0) {
+            if(my_id == 0) {
+                fprintf(stderr, "Bad scenario %d in %s\n", ensemble.number_of_scenarios + 1, name);
+            }
+            exit(EXIT_FAILURE);
+        }
+        ensemble.number_of_scenarios++;
+        if(ensemble.number_of_scenarios == capacity) {
+            capacity *= 2;
+            ensemble.scenarios = realloc(ensemble.scenarios, sizeof(scenario) * (unsigned long) capacity);
+        }
+    }
+    parser_destruct(&parser);
+    if(ensemble.number_of_scenarios == 0) {
+        if(my_id == 0) {
+            fprintf(stderr, "No scenario in %s\n", name);
+        }
+        exit(EXIT_FAILURE);
+    }
+
+    ensemble_make_groups(&ensemble, number_of_cpu);
+    ensemble.my_group = 0;
+    while(ensemble.group_first_cpu[ensemble.my_group + 1] <= my_id) {
+        ensemble.my_group++;
+    }
+    MPI_Comm_split(MPI_COMM_WORLD, ensemble.my_group, my_id, &ensemble.communicator);
+
+    return ensemble;
+}
+
+bool ensemble_is_enabled(ensemble ensemble) {
+    return ensemble.number_of_scenarios > 0;
+}
+
+void ensemble_destruct(ensemble* ensemble) {
+    if(!ensemble_is_enabled(*ensemble)) {
+        return;
+    }
+    free(ensemble->scenarios);
+    free(ensemble->group_of_scenario);
+    free(ensemble->group_first_cpu);
+    MPI_Comm_free(&ensemble->communicator);
+}
+
+/* Copy of items spread on MPI_COMM_WORLD to every group. Collective on MPI_COMM_WORLD
+ * The processes give their items to consecutive processes of each group, so the order of the items is kept.
+ * The result should be freed.
+ */
+void* ensemble_share(ensemble ensemble, const void* items, int count, int item_size, int* received) {
+    int my_id, number_of_cpu;
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
+    MPI_Comm_size(MPI_COMM_WORLD, &number_of_cpu);
+    int* send_counts = calloc((unsigned long) number_of_cpu, sizeof(int));
+    int* send_displacements = calloc((unsigned long) number_of_cpu, sizeof(int));
+    int* receive_counts = malloc(sizeof(int) * (unsigned long) number_of_cpu);
+    MPI_Datatype item_type;
+
+    for(int g = 0; g < ensemble.number_of_groups; g++) {
+        int size = ensemble.group_first_cpu[g + 1] - ensemble.group_first_cpu[g];
+        send_counts[ensemble.group_first_cpu[g] + (int) ((long) my_id * size / number_of_cpu)] = count;
+    }
+    MPI_Alltoall(send_counts, 1, MPI_INT, receive_counts, 1, MPI_INT, MPI_COMM_WORLD);
+    int* receive_displacements = displacements_from_counts(receive_counts, number_of_cpu);
+    *received = receive_displacements[number_of_cpu];
+    char* result = malloc((unsigned long) item_size * (unsigned long) (*received + 1));
+
+    MPI_Type_contiguous(item_size, MPI_BYTE, &item_type);
+    MPI_Type_commit(&item_type);
+    MPI_Alltoallv(
+                  items, send_counts, send_displacements, item_type,
+                  result, receive_counts, receive_displacements, item_type,
+                  MPI_COMM_WORLD
+                  );
+    MPI_Type_free(&item_type);
+
+    free(send_counts);
+    free(send_displacements);
+    free(receive_counts);
+    free(receive_displacements);
+    return result;
+}
+
+/* Print the results of the scenarios in the order of the file. Collective on MPI_COMM_WORLD
+ * texts and lengths are given by the process 0 of each group for its scenarios, the other processes give NULL.
+ */
+void ensemble_print(ensemble ensemble, char** texts, const long* lengths) {
+    int my_id, number_of_cpu;
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
+    MPI_Comm_size(MPI_COMM_WORLD, &number_of_cpu);
+    long* all_lengths = calloc((unsigned long) ensemble.number_of_scenarios, sizeof(long));
+    long length = 0;
+    int* counts = NULL;
+    int* displacements = NULL;
+    char* all_text = NULL;
+
+    //the texts of a group are sent together, in the order of the scenarios
+    if(texts != NULL) {
+        for(int i = 0; i < ensemble.number_of_scenarios; i++) {
+            if(ensemble.group_of_scenario[i] == ensemble.my_group) {
+                all_lengths[i] = lengths[i];
+                length += lengths[i];
+            }
+        }
+    }
+    char* text = malloc((unsigned long) length + 1);
+    length = 0;
+    if(texts != NULL) {
+        for(int i = 0; i < ensemble.number_of_scenarios; i++) {
+            if(ensemble.group_of_scenario[i] == ensemble.my_group) {
+                memcpy(text + length, texts[i], (unsigned long) lengths[i]);
+                length += lengths[i];
+            }
+        }
+    }
+
+    if(my_id == 0) {
+        counts = malloc(sizeof(int) * (unsigned long) number_of_cpu);
+        MPI_Reduce(MPI_IN_PLACE, all_lengths, ensemble.number_of_scenarios, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    } else {
+        MPI_Reduce(all_lengths, NULL, ensemble.number_of_scenarios, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+    if(length > INT_MAX) {
+        fprintf(stderr, "The results of the group %d are too long to be gathered.\n", ensemble.my_group);
+        exit(EXIT_FAILURE);
+    }
+    int sent_length = (int) length;
+    MPI_Gather(&sent_length, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if(my_id == 0) {
+        displacements = displacements_from_counts(counts, number_of_cpu);
+        all_text = malloc((unsigned long) displacements[number_of_cpu] + 1);
+    }
+    MPI_Gatherv(text, sent_length, MPI_CHAR, all_text, counts, displacements, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    if(my_id == 0) {
+        long* positions = malloc(sizeof(long) * (unsigned long) ensemble.number_of_groups);
+        for(int g = 0; g < ensemble.number_of_groups; g++) {
+            positions[g] = displacements[ensemble.group_first_cpu[g]];
+        }
+        for(int i = 0; i < ensemble.number_of_scenarios; i++) {
+            int g = ensemble.group_of_scenario[i];
+            printf("Scenario %d: p = %lf, t = %d\n", i + 1, ensemble.scenarios[i].p, ensemble.scenarios[i].t);
+            fwrite(all_text + positions[g], 1, (unsigned long) all_lengths[i], stdout);
+            positions[g] += all_lengths[i];
+        }
+        free(positions);
+        free(counts);
+        free(displacements);
+        free(all_text);
+    }
+
+    free(all_lengths);
+    free(text);
+}
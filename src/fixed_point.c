@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <mpi.h>
+
+/* Deterministic mode
+ * The values are kept multiples of 2^-bits and the weights multiples of 2^-FIXED_POINT_WEIGHT_BITS summing to 1.
+ * All the products and sums of a step are then integers times 2^-(bits + FIXED_POINT_WEIGHT_BITS) below 2^53
+ * times this unit: they are exact doubles, whatever the order of the operations, the vectorization or the tiling.
+ * Each step is rounded back to the nearest multiple of 2^-bits, so the results are the same bit for bit
+ * for any number of processes. The values should stay below the limit.
+ * The number of bits is chosen from the largest initial value, which is the same for any number of processes:
+ * the values may grow up to 2^FIXED_POINT_HEADROOM_BITS times it during the run. With at least FIXED_POINT_MIN_BITS bits,
+ * the initial values should be below 2^21 / (sum of the absolute values of the weights), about two millions for von Neumann.
+ */
+#define FIXED_POINT_MAX_BITS 32
+#define FIXED_POINT_MIN_BITS 8
+#define FIXED_POINT_WEIGHT_BITS 20
+#define FIXED_POINT_HEADROOM_BITS 4
+
+typedef struct fixed_point {
+    int bits;
+    double unit;   //2^bits
+    double limit;  //bound of the values for which a step is exact
+} fixed_point;
+
+//weights rounded to multiples of 2^-FIXED_POINT_WEIGHT_BITS, the largest one keeps the sum equal to 1
+void stencil_kernel_to_fixed_point(stencil_kernel* kernel) {
+    double unit = ldexp(1, FIXED_POINT_WEIGHT_BITS);
+    double sum = 0;
+    int largest = 0;
+
+    for(int k = 0; k < kernel->size; k++) {
+        kernel->weights[k] = nearbyint(kernel->weights[k] * unit);
+        sum += kernel->weights[k];
+        largest = (kernel->weights[k] > kernel->weights[largest]) ? k : largest;
+    }
+    kernel->weights[largest] += unit - sum;
+    for(int k = 0; k < kernel->size; k++) {
+        kernel->weights[k] /= unit;
+    }
+}
+
+//largest absolute value of the fields of the tile
+double tile_largest_value(tile tile) {
+    double largest = 0;
+
+    for(int x = 0; x < tile.size.x; x++) {
+        const double* values = &tile.data[tile_index(tile, x, 0)];
+        for(long i = 0; i < (long) tile.size.y * tile.fields; i++) {
+            largest = (fabs(values[i]) > largest) ? fabs(values[i]) : largest;
+        }
+    }
+    return largest;
+}
+
+/* Number of bits for the initial values of the tiles and the fixed point kernel. Collective
+ * The maximum is exact, so every process gets the same number of bits.
+ */
+fixed_point fixed_point_init(stencil_kernel kernel, tile my_tile) {
+    fixed_point fixed_point;
+    double sum = 0;
+    double my_largest = tile_largest_value(my_tile);
+    double largest;
+    int exponent;
+
+    for(int k = 0; k < kernel.size; k++) {
+        sum += fabs(kernel.weights[k]);
+    }
+    MPI_Allreduce(&my_largest, &largest, 1, MPI_DOUBLE, MPI_MAX, get_communicator());
+
+    //largest * sum < 2^exponent
+    frexp(largest * sum, &exponent);
+    fixed_point.bits = 53 - FIXED_POINT_WEIGHT_BITS - FIXED_POINT_HEADROOM_BITS - exponent;
+    fixed_point.bits = (fixed_point.bits > FIXED_POINT_MAX_BITS) ? FIXED_POINT_MAX_BITS : fixed_point.bits;
+    if(fixed_point.bits < FIXED_POINT_MIN_BITS) {
+        if(get_my_id() == 0) {
+            fprintf(stderr, "The initial values are too large for the deterministic mode (%lf).\n", largest);
+        }
+        exit(EXIT_FAILURE);
+    }
+    fixed_point.unit = ldexp(1, fixed_point.bits);
+    fixed_point.limit = ldexp(1, 53 - fixed_point.bits - FIXED_POINT_WEIGHT_BITS) / sum;
+
+    return fixed_point;
+}
+
+//nearest multiple of 2^-bits, the ties to even. Adding 1.5 * 2^52 drops the fractional part without a call to the libm
+double fixed_point_round(fixed_point fixed_point, double value) {
+    double scaled = value * fixed_point.unit;
+    return ((scaled + 0x1.8p52) - 0x1.8p52) / fixed_point.unit;
+}
+
+//round the fields of the rectangle of the tile starting at first, which should be below the limit
+void tile_round_to_fixed_point(tile* tile, coordinates first, coordinates size, fixed_point fixed_point) {
+    double largest = 0;
+
+    for(int x = first.x; x < first.x + size.x; x++) {
+        double* values = &tile->data[tile_index(*tile, x, first.y)];
+        for(long i = 0; i < (long) size.y * tile->fields; i++) {
+            values[i] = fixed_point_round(fixed_point, values[i]);
+            largest = (fabs(values[i]) > largest) ? fabs(values[i]) : largest;
+        }
+    }
+
+    if(largest >= fixed_point.limit) {
+        fprintf(stderr, "A value is out of the range of the deterministic mode (%lf).\n", fixed_point.limit);
+        exit(EXIT_FAILURE);
+    }
+}
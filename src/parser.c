@@ -0,0 +1,437 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <mpi.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Input parsing
+ * The input is either the file given by -i, mapped in memory by all the processes, or the standard input read by the process 0 by large chunks.
+ * The numbers are read by a hand written tokenizer: strtod is only used for the unusual forms of doubles (exponent, long mantissa...).
+ * With a file, the lines after the header are split between the processes which parse them in parallel.
+ * Bad lines are reported with their number and skipped.
+ */
+#define PARSER_CHUNK_SIZE (1 << 20)
+
+typedef struct entry {
+    int type;
+    coordinates coord;
+    double value;
+    int field;     //field of the value when several fields are computed together
+    long line;
+} entry;
+
+typedef struct parser {
+    char* data;
+    long position;
+    long end;
+    long line;
+    int file;      //file descriptor to read the next chunks from, -1 if there is nothing more to read
+    bool mapped;
+    long capacity; //size of the buffer or of the mapped file
+} parser;
+
+parser parser_empty() {
+    parser parser;
+    parser.data = NULL;
+    parser.position = 0;
+    parser.end = 0;
+    parser.line = 1;
+    parser.file = -1;
+    parser.mapped = false;
+    parser.capacity = 0;
+    return parser;
+}
+
+parser parser_from_file(const char* name) {
+    parser parser = parser_empty();
+    struct stat file_stat;
+    int file = open(name, O_RDONLY);
+
+    if(file < 0 || fstat(file, &file_stat) != 0) {
+        fprintf(stderr, "Unable to open %s\n", name);
+        exit(EXIT_FAILURE);
+    }
+    parser.mapped = true;
+    parser.capacity = (long) file_stat.st_size;
+    parser.end = parser.capacity;
+    if(parser.capacity > 0) {
+        parser.data = mmap(NULL, (size_t) parser.capacity, PROT_READ, MAP_PRIVATE, file, 0);
+        if(parser.data == MAP_FAILED) {
+            fprintf(stderr, "Unable to map %s\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    close(file);
+
+    return parser;
+}
+
+parser parser_from_descriptor(int file) {
+    parser parser = parser_empty();
+    parser.file = file;
+    parser.capacity = PARSER_CHUNK_SIZE;
+    parser.data = malloc((unsigned long) parser.capacity);
+    return parser;
+}
+
+//the input file is given by -i, else the process 0 reads the standard input
+parser parser_from_arguments(int argc, char* argv[]) {
+    const char* name = get_argument_value(argc, argv, "-i");
+
+    if(name != NULL) {
+        return parser_from_file(name);
+    }
+    return (get_my_id() == 0) ? parser_from_descriptor(STDIN_FILENO) : parser_empty();
+}
+
+bool parser_is_mapped(parser parser) {
+    return parser.mapped;
+}
+
+void parser_destruct(parser* parser) {
+    if(parser->mapped) {
+        if(parser->data != NULL) {
+            munmap(parser->data, (size_t) parser->capacity);
+        }
+    } else {
+        free(parser->data);
+    }
+}
+
+//read the next chunk after the remaining data. Return false if there is nothing more to read
+bool parser_fill(parser* parser) {
+    if(parser->file < 0) {
+        return false;
+    }
+
+    long remaining = parser->end - parser->position;
+    memmove(parser->data, parser->data + parser->position, (unsigned long) remaining);
+    parser->position = 0;
+    parser->end = remaining;
+    if(remaining == parser->capacity) {
+        parser->capacity *= 2;
+        parser->data = realloc(parser->data, (unsigned long) parser->capacity);
+    }
+
+    ssize_t size = read(parser->file, parser->data + parser->end, (unsigned long) (parser->capacity - parser->end));
+    if(size <= 0) {
+        parser->file = -1;
+        return false;
+    }
+    parser->end += size;
+    return true;
+}
+
+//make sure the current line is fully in the buffer
+void parser_ensure_line(parser* parser) {
+    while(memchr(parser->data + parser->position, '\n', (unsigned long) (parser->end - parser->position)) == NULL && parser_fill(parser)) {
+    }
+}
+
+bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+//skip the spaces and the end of lines. Return false at the end of the input
+bool parser_skip_spaces(parser* parser) {
+    while(true) {
+        if(parser->position == parser->end && !parser_fill(parser)) {
+            return false;
+        }
+        char c = parser->data[parser->position];
+        if(c == '\n') {
+            parser->line++;
+        } else if(!is_blank(c)) {
+            parser_ensure_line(parser);
+            return true;
+        }
+        parser->position++;
+    }
+}
+
+//skip the spaces in the current line. Return false at the end of the line
+bool parser_skip_blanks(parser* parser) {
+    while(parser->position < parser->end && is_blank(parser->data[parser->position])) {
+        parser->position++;
+    }
+    return parser->position < parser->end && parser->data[parser->position] != '\n';
+}
+
+void parser_skip_line(parser* parser) {
+    while(parser->position < parser->end && parser->data[parser->position] != '\n') {
+        parser->position++;
+    }
+}
+
+bool parser_at_token_end(parser parser) {
+    return parser.position == parser.end || is_blank(parser.data[parser.position]) || parser.data[parser.position] == '\n';
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool parser_read_int(parser* parser, int* value) {
+    bool negative = false;
+    long result = 0;
+    long start;
+
+    if(parser->position < parser->end && (parser->data[parser->position] == '-' || parser->data[parser->position] == '+')) {
+        negative = parser->data[parser->position] == '-';
+        parser->position++;
+    }
+    start = parser->position;
+    while(parser->position < parser->end && is_digit(parser->data[parser->position])) {
+        result = result * 10 + (parser->data[parser->position] - '0');
+        if(result > INT_MAX) {
+            return false;
+        }
+        parser->position++;
+    }
+
+    *value = (int) (negative ? -result : result);
+    return parser->position > start && parser_at_token_end(*parser);
+}
+
+//exact powers of ten as doubles
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//slow path with strtod for the forms the fast path does not handle
+bool parser_read_double_with_strtod(parser* parser, double* value) {
+    char token[64];
+    long length = 0;
+    char* token_end;
+
+    while(parser->position + length < parser->end && !is_blank(parser->data[parser->position + length]) && parser->data[parser->position + length] != '\n') {
+        length++;
+    }
+    if(length == 0 || length >= (long) sizeof(token)) {
+        return false;
+    }
+    memcpy(token, parser->data + parser->position, (unsigned long) length);
+    token[length] = '\0';
+
+    *value = strtod(token, &token_end);
+    parser->position += length;
+    return token_end == token + length;
+}
+
+/* Fast path: [sign] digits [. digits] with at most 15 significant digits
+ * The mantissa is then exact and the division by an exact power of ten is correctly rounded.
+ */
+bool parser_read_double(parser* parser, double* value) {
+    long start = parser->position;
+    bool negative = false;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int decimals = 0;
+
+    if(parser->position < parser->end && (parser->data[parser->position] == '-' || parser->data[parser->position] == '+')) {
+        negative = parser->data[parser->position] == '-';
+        parser->position++;
+    }
+    while(parser->position < parser->end && is_digit(parser->data[parser->position])) {
+        mantissa = mantissa * 10 + (uint64_t) (parser->data[parser->position] - '0');
+        digits++;
+        parser->position++;
+    }
+    if(parser->position < parser->end && parser->data[parser->position] == '.') {
+        parser->position++;
+        while(parser->position < parser->end && is_digit(parser->data[parser->position])) {
+            mantissa = mantissa * 10 + (uint64_t) (parser->data[parser->position] - '0');
+            digits++;
+            decimals++;
+            parser->position++;
+        }
+    }
+
+    if(digits == 0 || digits > 15 || !parser_at_token_end(*parser)) {
+        parser->position = start;
+        return parser_read_double_with_strtod(parser, value);
+    }
+
+    *value = (double) mantissa / powers_of_ten[decimals];
+    if(negative) {
+        *value = -*value;
+    }
+    return true;
+}
+
+//numbers of the header, which can be on several lines
+bool parser_next_int(parser* parser, int* value) {
+    return parser_skip_spaces(parser) && parser_read_int(parser, value);
+}
+
+bool parser_next_double(parser* parser, double* value) {
+    return parser_skip_spaces(parser) && parser_read_double(parser, value);
+}
+
+//count integers of the current line separated by blanks, the first one at the position
+bool parser_read_ints(parser* parser, int* values, int count) {
+    for(int i = 0; i < count; i++) {
+        if((i > 0 && !parser_skip_blanks(parser)) || !parser_read_int(parser, &values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//report a bad entry line, or a valid one with an unknown type, and skip it
+void parser_reject_line(parser* parser, long line, bool valid, int type) {
+    if(valid) {
+        fprintf(stderr, "Line %ld: unknown description type %d\n", line, type);
+    } else {
+        fprintf(stderr, "Line %ld: bad entry\n", line);
+    }
+    parser_skip_line(parser);
+}
+
+/* Entries "type x y value", one per line
+ * With several fields, a value line can also give the values of all the fields: "type x y value_1 ... value_fields".
+ * A value line with one value sets all the fields, a GET line always gives one entry.
+ * The entries of the line are given in entries, their number is returned, 0 at the end of the input.
+ */
+int parser_next_entries(parser* parser, entry* entries, int fields) {
+    while(parser_skip_spaces(parser)) {
+        int count = 1;
+        int numbers[3] = {0, 0, 0};
+        entries[0].line = parser->line;
+        entries[0].field = 0;
+        bool valid = parser_read_ints(parser, numbers, 3) && parser_skip_blanks(parser) && parser_read_double(parser, &entries[0].value);
+        entries[0].type = numbers[0];
+        entries[0].coord = coordinates_init(numbers[1], numbers[2]);
+        while(valid && count < fields && parser_skip_blanks(parser)) {
+            entries[count] = entries[0];
+            entries[count].field = count;
+            valid = parser_read_double(parser, &entries[count].value);
+            count++;
+        }
+        valid = valid && !parser_skip_blanks(parser) && (count == 1 || count == fields);
+
+        if(valid && entries[0].type == 2) {
+            //a GET is one request, whatever the number of values of the line
+            entries[0].field = 0;
+            return 1;
+        }
+        if(valid && entries[0].type >= 0 && entries[0].type < 2) {
+            if(count == 1) {
+                for(count = 1; count < fields; count++) {
+                    entries[count] = entries[0];
+                    entries[count].field = count;
+                }
+            }
+            return count;
+        }
+        parser_reject_line(parser, entries[0].line, valid, entries[0].type);
+    }
+
+    return 0;
+}
+
+//beginning of the first line starting at or after position
+long parser_line_start(parser parser, long start, long position) {
+    if(position <= start) {
+        return start;
+    }
+    const char* end_of_line = memchr(parser.data + position - 1, '\n', (unsigned long) (parser.end - position + 1));
+    return (end_of_line == NULL) ? parser.end : end_of_line - parser.data + 1;
+}
+
+long parser_count_lines(parser parser, long start, long end) {
+    long lines = 0;
+    const char* position = parser.data + start;
+    const char* limit = parser.data + end;
+    while((position = memchr(position, '\n', (unsigned long) (limit - position))) != NULL) {
+        lines++;
+        position++;
+    }
+    return lines;
+}
+
+//restrict a mapped parser to the part of the remaining lines of the process. Collective
+void parser_split(parser* parser) {
+    if(!parser->mapped) {
+        return;
+    }
+
+    int my_id = get_my_id();
+    int number_of_cpu = get_number_of_cpu();
+    long start = parser->position;
+    long length = parser->end - start;
+    long my_start = parser_line_start(*parser, start, start + length * my_id / number_of_cpu);
+    long my_end = parser_line_start(*parser, start, start + length * (my_id + 1) / number_of_cpu);
+    long lines = (my_end > my_start) ? parser_count_lines(*parser, my_start, my_end) : 0;
+    long previous_lines = 0;
+
+    //the lines keep their numbers in the file, header included
+    MPI_Exscan(&lines, &previous_lines, 1, MPI_LONG, MPI_SUM, get_communicator());
+    if(my_id == 0) {
+        previous_lines = 0;
+    }
+
+    parser->line += previous_lines;
+    parser->position = my_start;
+    parser->end = my_end;
+}
+
+//all the entries of the parser, for the given number of fields. The result should be freed
+entry* parse_entries_with_fields(parser* parser, int fields, int* count) {
+    int capacity = 1024 + fields;
+    entry* entries = malloc(sizeof(entry) * (unsigned long) capacity);
+    int read;
+
+    *count = 0;
+    while((read = parser_next_entries(parser, &entries[*count], fields)) > 0) {
+        *count += read;
+        if(*count + fields > capacity) {
+            capacity *= 2;
+            entries = realloc(entries, sizeof(entry) * (unsigned long) capacity);
+        }
+    }
+
+    return entries;
+}
+
+entry* parse_entries(parser* parser, int* count) {
+    return parse_entries_with_fields(parser, 1, count);
+}
+
+/* Split the entries between the initial values, which are before the first request, and the requests
+ * The initial values are moved at the beginning of entries and their number is returned. Collective
+ */
+int entries_split_requests(entry* entries, int count, coordinates** requests, int* number_of_requests) {
+    long first_request = LONG_MAX;
+    long my_first_request = LONG_MAX;
+    int number_of_values = 0;
+
+    *number_of_requests = 0;
+    for(int i = 0; i < count; i++) {
+        if(entries[i].type == 2) {
+            (*number_of_requests)++;
+            if(entries[i].line < my_first_request) {
+                my_first_request = entries[i].line;
+            }
+        }
+    }
+    MPI_Allreduce(&my_first_request, &first_request, 1, MPI_LONG, MPI_MIN, get_communicator());
+
+    *requests = malloc(sizeof(coordinates) * (unsigned long) (*number_of_requests + 1));
+    *number_of_requests = 0;
+    for(int i = 0; i < count; i++) {
+        if(entries[i].type == 2) {
+            (*requests)[(*number_of_requests)++] = entries[i].coord;
+        } else if(entries[i].line < first_request) {
+            entries[number_of_values++] = entries[i];
+        }
+    }
+
+    return number_of_values;
+}
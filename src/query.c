@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <mpi.h>
+
+/* Parallel answer of the GET requests
+ * Each process gives the requests it has read. They are bucketed by owning tile and sent with a MPI_Alltoallv,
+ * the owners answer from their tile and the values come back with a second MPI_Alltoallv in the order of the requests.
+ * No process needs more than its own tile.
+ */
+typedef struct query_batch {
+    int count;               //number of requests of the process
+    int* order;              //position of each request of the process in the send buffer
+    int* send_counts;
+    int* send_displacements;
+    int* receive_counts;
+    int* receive_displacements;
+    int received;            //number of requests the process should answer
+    coordinates* requests;   //requests to answer, in the torus coordinates
+    int fields;              //number of values of each answer
+    double* values;          //answers to fill
+} query_batch;
+
+int tiling_owner(tiling tiling, coordinates coord) {
+    return cpu_id_from_coordinates_with_mod(
+                                            tiling_find_part(tiling.x_bounds, tiling.grid_size.x, coord.x),
+                                            tiling_find_part(tiling.y_bounds, tiling.grid_size.y, coord.y),
+                                            tiling.grid_size
+                                            );
+}
+
+int* displacements_from_counts(const int* counts, int size) {
+    int* displacements = malloc(sizeof(int) * (unsigned long) (size + 1));
+    displacements[0] = 0;
+    for(int i = 0; i < size; i++) {
+        displacements[i + 1] = displacements[i] + counts[i];
+    }
+    return displacements;
+}
+
+//owner of each coordinate, and permutation which bucket them by owner
+int* tiling_bucket_by_owner(tiling tiling, coordinates* coords, int count, int* counts, int** displacements) {
+    int number_of_cpu = tiling.grid_size.x * tiling.grid_size.y;
+    int* owners = malloc(sizeof(int) * (unsigned long) (count + 1));
+    int* order = malloc(sizeof(int) * (unsigned long) (count + 1));
+
+    for(int i = 0; i < number_of_cpu; i++) {
+        counts[i] = 0;
+    }
+    for(int i = 0; i < count; i++) {
+        coords[i] = coordinates_init(mod(coords[i].x, tiling.matrix_size.x), mod(coords[i].y, tiling.matrix_size.y));
+        owners[i] = tiling_owner(tiling, coords[i]);
+        counts[owners[i]]++;
+    }
+    *displacements = displacements_from_counts(counts, number_of_cpu);
+    int* positions = malloc(sizeof(int) * (unsigned long) number_of_cpu);
+    for(int i = 0; i < number_of_cpu; i++) {
+        positions[i] = (*displacements)[i];
+    }
+    for(int i = 0; i < count; i++) {
+        order[i] = positions[owners[i]]++;
+    }
+
+    free(positions);
+    free(owners);
+    return order;
+}
+
+//send the requests to their owners. Collective
+query_batch query_batch_distribute(tiling tiling, const coordinates* requests, int count) {
+    query_batch batch;
+    int number_of_cpu = tiling.grid_size.x * tiling.grid_size.y;
+    coordinates* coords = malloc(sizeof(coordinates) * (unsigned long) (count + 1));
+    coordinates* send_buffer = malloc(sizeof(coordinates) * (unsigned long) (count + 1));
+    MPI_Datatype coordinates_type;
+
+    batch.count = count;
+    batch.send_counts = malloc(sizeof(int) * (unsigned long) number_of_cpu);
+    batch.receive_counts = malloc(sizeof(int) * (unsigned long) number_of_cpu);
+
+    //bucket sort by owner
+    for(int i = 0; i < count; i++) {
+        coords[i] = requests[i];
+    }
+    batch.order = tiling_bucket_by_owner(tiling, coords, count, batch.send_counts, &batch.send_displacements);
+    for(int i = 0; i < count; i++) {
+        send_buffer[batch.order[i]] = coords[i];
+    }
+
+    MPI_Alltoall(batch.send_counts, 1, MPI_INT, batch.receive_counts, 1, MPI_INT, get_communicator());
+    batch.receive_displacements = displacements_from_counts(batch.receive_counts, number_of_cpu);
+    batch.received = batch.receive_displacements[number_of_cpu];
+    batch.requests = malloc(sizeof(coordinates) * (unsigned long) (batch.received + 1));
+    batch.fields = 0;
+    batch.values = NULL;
+
+    MPI_Type_contiguous(2, MPI_INT, &coordinates_type);
+    MPI_Type_commit(&coordinates_type);
+    MPI_Alltoallv(
+                  send_buffer, batch.send_counts, batch.send_displacements, coordinates_type,
+                  batch.requests, batch.receive_counts, batch.receive_displacements, coordinates_type,
+                  get_communicator()
+                  );
+    MPI_Type_free(&coordinates_type);
+
+    free(coords);
+    free(send_buffer);
+    return batch;
+}
+
+//answer the requests from the tile owned by the process, with all the fields of the tile
+void query_batch_answer_from_tile(query_batch* batch, tile my_tile) {
+    batch->fields = my_tile.fields;
+    batch->values = malloc(sizeof(double) * (unsigned long) (batch->received * batch->fields + 1));
+    for(int i = 0; i < batch->received; i++) {
+        for(int field = 0; field < batch->fields; field++) {
+            batch->values[i * batch->fields + field] = tile_get_field(my_tile, field, batch->requests[i].x - my_tile.offset.x, batch->requests[i].y - my_tile.offset.y);
+        }
+    }
+}
+
+//send back the values. Collective, the result is in the order of the requests of the process and should be freed
+double* query_batch_collect(query_batch* batch) {
+    double* receive_buffer = malloc(sizeof(double) * (unsigned long) (batch->count * batch->fields + 1));
+    double* values = malloc(sizeof(double) * (unsigned long) (batch->count * batch->fields + 1));
+    MPI_Datatype answer_type;
+
+    MPI_Type_contiguous(batch->fields, MPI_DOUBLE, &answer_type);
+    MPI_Type_commit(&answer_type);
+    MPI_Alltoallv(
+                  batch->values, batch->receive_counts, batch->receive_displacements, answer_type,
+                  receive_buffer, batch->send_counts, batch->send_displacements, answer_type,
+                  get_communicator()
+                  );
+    MPI_Type_free(&answer_type);
+    for(int i = 0; i < batch->count; i++) {
+        for(int field = 0; field < batch->fields; field++) {
+            values[i * batch->fields + field] = receive_buffer[batch->order[i] * batch->fields + field];
+        }
+    }
+
+    free(receive_buffer);
+    return values;
+}
+
+void query_batch_destruct(query_batch* batch) {
+    free(batch->order);
+    free(batch->send_counts);
+    free(batch->send_displacements);
+    free(batch->receive_counts);
+    free(batch->receive_displacements);
+    free(batch->requests);
+    free(batch->values);
+}
+
+//append a formatted line to a text growing as needed, *length and *capacity are in bytes
+void text_append(char** text, long* length, long* capacity, const char* format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    long needed = vsnprintf(NULL, 0, format, arguments);
+    va_end(arguments);
+
+    if(*length + needed + 1 > *capacity) {
+        while(*length + needed + 1 > *capacity) {
+            *capacity *= 2;
+        }
+        *text = realloc(*text, (unsigned long) *capacity);
+    }
+    va_start(arguments, format);
+    vsnprintf(*text + *length, (unsigned long) (*capacity - *length), format, arguments);
+    va_end(arguments);
+    *length += needed;
+}
+
+/* Text of the answers in the order of the requests of the processes. Collective
+ * Each answer has fields values. The text is returned on the process 0 with its length and should be freed,
+ * the other processes get NULL.
+ */
+char* query_format_answers(const coordinates* requests, const double* values, int count, int fields, long* total_length) {
+    int my_id = get_my_id();
+    int number_of_cpu = get_number_of_cpu();
+    long capacity = 256;
+    long length = 0;
+    char* text = malloc((unsigned long) capacity);
+    int* lengths = NULL;
+    int* displacements = NULL;
+    char* all_text = NULL;
+
+    for(int i = 0; i < count; i++) {
+        text_append(&text, &length, &capacity, "Value of case (%d, %d) is %lf", requests[i].x, requests[i].y, values[i * fields]);
+        for(int field = 1; field < fields; field++) {
+            text_append(&text, &length, &capacity, " %lf", values[i * fields + field]);
+        }
+        text_append(&text, &length, &capacity, ".\n");
+    }
+    if(length > INT_MAX) {
+        fprintf(stderr, "The answers of the process %d are too long to be gathered.\n", my_id);
+        exit(EXIT_FAILURE);
+    }
+
+    int sent_length = (int) length;
+    if(my_id == 0) {
+        lengths = malloc(sizeof(int) * (unsigned long) number_of_cpu);
+    }
+    MPI_Gather(&sent_length, 1, MPI_INT, lengths, 1, MPI_INT, 0, get_communicator());
+    if(my_id == 0) {
+        displacements = displacements_from_counts(lengths, number_of_cpu);
+        *total_length = displacements[number_of_cpu];
+        all_text = malloc((unsigned long) *total_length + 1);
+    }
+    MPI_Gatherv(text, sent_length, MPI_CHAR, all_text, lengths, displacements, MPI_CHAR, 0, get_communicator());
+    if(my_id == 0) {
+        free(lengths);
+        free(displacements);
+    }
+
+    free(text);
+    return all_text;
+}
+
+//print the answers in the order of the requests of the processes. Collective
+void query_print_answers(const coordinates* requests, const double* values, int count, int fields) {
+    long length;
+    char* text = query_format_answers(requests, values, count, fields, &length);
+
+    if(text != NULL) {
+        fwrite(text, 1, (unsigned long) length, stdout);
+        free(text);
+    }
+}
+
+
+/* Initial values of the cases sent to the owners of the cases. Collective
+ * The entries of a process keep their order, so the last value given for a case wins.
+ */
+entry* entries_distribute(tiling tiling, const entry* entries, int count, int* received) {
+    int number_of_cpu = tiling.grid_size.x * tiling.grid_size.y;
+    int* send_counts = malloc(sizeof(int) * (unsigned long) number_of_cpu);
+    int* receive_counts = malloc(sizeof(int) * (unsigned long) number_of_cpu);
+    int* send_displacements;
+    int* receive_displacements;
+    coordinates* coords = malloc(sizeof(coordinates) * (unsigned long) (count + 1));
+    entry* send_buffer = malloc(sizeof(entry) * (unsigned long) (count + 1));
+    MPI_Datatype entry_type;
+
+    for(int i = 0; i < count; i++) {
+        coords[i] = entries[i].coord;
+    }
+    int* order = tiling_bucket_by_owner(tiling, coords, count, send_counts, &send_displacements);
+    for(int i = 0; i < count; i++) {
+        send_buffer[order[i]] = entries[i];
+        send_buffer[order[i]].coord = coords[i];
+    }
+
+    MPI_Alltoall(send_counts, 1, MPI_INT, receive_counts, 1, MPI_INT, get_communicator());
+    receive_displacements = displacements_from_counts(receive_counts, number_of_cpu);
+    *received = receive_displacements[number_of_cpu];
+    entry* result = malloc(sizeof(entry) * (unsigned long) (*received + 1));
+
+    MPI_Type_contiguous((int) sizeof(entry), MPI_BYTE, &entry_type);
+    MPI_Type_commit(&entry_type);
+    MPI_Alltoallv(
+                  send_buffer, send_counts, send_displacements, entry_type,
+                  result, receive_counts, receive_displacements, entry_type,
+                  get_communicator()
+                  );
+    MPI_Type_free(&entry_type);
+
+    free(send_counts);
+    free(receive_counts);
+    free(send_displacements);
+    free(receive_displacements);
+    free(coords);
+    free(order);
+    free(send_buffer);
+    return result;
+}
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <mpi.h>
+
+/* Ring allgather of the tiles
+ * Each process gets a copy of the whole matrix, block by block, without any collective: the tiles first go around
+ * the rings of the lines of the grid, so each process gets the strip of its grid line, then the strips go around
+ * the rings of the columns of the grid. This is grid_size.x + grid_size.y - 2 shifts with the neighbours.
+ * The next shift is started before the received block is given back, so the work on a block is overlapped with the
+ * transfer of the next one. The block of any case follows from the tiling, so there is no map of the received cases.
+ */
+typedef struct ring_allgather {
+    tiling tiling;
+    coordinates tile_coordinates;
+    double* matrix;          //whole matrix, line by line
+    int* column_blocks;      //block of each column in the strip of the process
+    int number_of_blocks;
+    int next_block;
+    MPI_Request requests[2];
+} ring_allgather;
+
+//lines of the strip of the line i of the grid
+void ring_allgather_strip(ring_allgather ring, int i, coordinates* offset, coordinates* size) {
+    *offset = coordinates_init(ring.tiling.x_bounds[i], 0);
+    *size = coordinates_init(ring.tiling.x_bounds[i + 1] - ring.tiling.x_bounds[i], ring.tiling.matrix_size.y);
+}
+
+//the first blocks are the tiles of the grid line of the process, the next ones the strips of the other grid lines
+void ring_allgather_block(ring_allgather ring, int block, coordinates* offset, coordinates* size) {
+    if(block < ring.tiling.grid_size.y) {
+        coordinates tile_coordinates = coordinates_init(ring.tile_coordinates.x, mod(ring.tile_coordinates.y - block, ring.tiling.grid_size.y));
+        *offset = tiling_tile_offset(ring.tiling, tile_coordinates);
+        *size = tiling_tile_size(ring.tiling, tile_coordinates);
+    } else {
+        ring_allgather_strip(ring, mod(ring.tile_coordinates.x - (block - ring.tiling.grid_size.y + 1), ring.tiling.grid_size.x), offset, size);
+    }
+}
+
+//receive the block block from the previous process of the ring and send it the one before to the next process
+void ring_allgather_start_shift(ring_allgather* ring, int block) {
+    coordinates offset, size;
+    coordinates previous, next;
+    MPI_Datatype type;
+
+    if(block < ring->tiling.grid_size.y) {
+        previous = coordinates_init(ring->tile_coordinates.x, ring->tile_coordinates.y - 1);
+        next = coordinates_init(ring->tile_coordinates.x, ring->tile_coordinates.y + 1);
+        ring_allgather_block(*ring, block - 1, &offset, &size);
+    } else {
+        previous = coordinates_init(ring->tile_coordinates.x - 1, ring->tile_coordinates.y);
+        next = coordinates_init(ring->tile_coordinates.x + 1, ring->tile_coordinates.y);
+        ring_allgather_strip(*ring, mod(ring->tile_coordinates.x - (block - ring->tiling.grid_size.y), ring->tiling.grid_size.x), &offset, &size);
+    }
+
+    type = matrix_block_type(ring->tiling.matrix_size, offset, size);
+    MPI_Isend(ring->matrix, 1, type, cpu_id_from_coordinates_with_mod(next.x, next.y, ring->tiling.grid_size), block, get_communicator(), &ring->requests[1]);
+    MPI_Type_free(&type);
+
+    ring_allgather_block(*ring, block, &offset, &size);
+    type = matrix_block_type(ring->tiling.matrix_size, offset, size);
+    MPI_Irecv(ring->matrix, 1, type, cpu_id_from_coordinates_with_mod(previous.x, previous.y, ring->tiling.grid_size), block, get_communicator(), &ring->requests[0]);
+    MPI_Type_free(&type);
+}
+
+//matrix should have the size of the matrix
+ring_allgather ring_allgather_init(tiling tiling, tile my_tile, double* matrix) {
+    ring_allgather ring;
+    ring.tiling = tiling;
+    ring.tile_coordinates = my_tile.grid_coordinates;
+    ring.matrix = matrix;
+    ring.number_of_blocks = tiling.grid_size.x + tiling.grid_size.y - 1;
+    ring.next_block = 0;
+
+    //the tile of the column part j comes after mod(y - j, grid_size.y) shifts
+    ring.column_blocks = malloc(sizeof(int) * (unsigned long) tiling.matrix_size.y);
+    for(int y = 0; y < tiling.matrix_size.y; y++) {
+        ring.column_blocks[y] = mod(ring.tile_coordinates.y - tiling_find_part(tiling.y_bounds, tiling.grid_size.y, y), tiling.grid_size.y);
+    }
+    for(int x = 0; x < my_tile.size.x; x++) {
+        for(int y = 0; y < my_tile.size.y; y++) {
+            matrix[(my_tile.offset.x + x) * tiling.matrix_size.y + my_tile.offset.y + y] = tile_get_case(my_tile, x, y);
+        }
+    }
+
+    return ring;
+}
+
+void ring_allgather_destruct(ring_allgather* ring) {
+    free(ring->column_blocks);
+}
+
+/* Block of the cases of the line x, the inverse of ring_allgather_block
+ * The lines of the strip of the process return -1: their blocks are given by column_blocks.
+ */
+int ring_allgather_line_block(ring_allgather ring, int x) {
+    int strip = tiling_find_part(ring.tiling.x_bounds, ring.tiling.grid_size.x, x);
+    if(strip == ring.tile_coordinates.x) {
+        return -1;
+    }
+    return ring.tiling.grid_size.y - 1 + mod(ring.tile_coordinates.x - strip, ring.tiling.grid_size.x);
+}
+
+/* Wait for the next block and start the transfer of the following one. Collective
+ * Return false when the whole matrix has been received.
+ */
+bool ring_allgather_next(ring_allgather* ring, int* block, coordinates* offset, coordinates* size) {
+    if(ring->next_block == ring->number_of_blocks) {
+        return false;
+    }
+
+    *block = ring->next_block++;
+    if(*block > 0) {
+        MPI_Waitall(2, ring->requests, MPI_STATUSES_IGNORE);
+    }
+    if(ring->next_block < ring->number_of_blocks) {
+        ring_allgather_start_shift(ring, ring->next_block);
+    }
+
+    ring_allgather_block(*ring, *block, offset, size);
+    return true;
+}
@@ -3,6 +3,7 @@
 #include <mpi.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
 
 /* Quelques structures utiles */
 typedef struct coordinates {
@@ -22,24 +23,30 @@ inline bool coordinates_equals(coordinates a, coordinates b) {
 }
 
 /* Useful functions */
+
+//the processes working together: MPI_COMM_WORLD, or a group of processes when the job is split
+static MPI_Comm current_communicator = MPI_COMM_NULL;
+
+MPI_Comm get_communicator() {
+    return (current_communicator == MPI_COMM_NULL) ? MPI_COMM_WORLD : current_communicator;
+}
+
+void set_communicator(MPI_Comm communicator) {
+    current_communicator = communicator;
+}
+
 int get_my_id() {
     int my_id;
-    MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
+    MPI_Comm_rank(get_communicator(), &my_id);
     return my_id;
 }
 
 int get_number_of_cpu() {
     int number;
-    MPI_Comm_size(MPI_COMM_WORLD, &number);
+    MPI_Comm_size(get_communicator(), &number);
     return number;
 }
 
-coordinates get_my_cell_coordinates(coordinates grid_size) {
-    int my_id = get_my_id();
-    
-    return coordinates_init(my_id / grid_size.y, my_id % grid_size.y);
-}
-
 int mod(int val, const int mod) {
     while(val < 0) {
         val += mod;
@@ -51,20 +58,50 @@ int cpu_id_from_coordinates_with_mod(int x, int y, coordinates grid_size) {
     return mod(x, grid_size.x) * grid_size.y + mod(y, grid_size.y);
 }
 
-//do variable move in the matrix. from is the pid from which we shoud get data and to the pid to which we shoud send val
-double move_double(int from, int to, double val) {
-    MPI_Send(&val, 1, MPI_DOUBLE, to, 0, MPI_COMM_WORLD);
-    MPI_Recv(&val, 1, MPI_DOUBLE, from, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    
-    return val;
+/* Aligned memory
+ * The blocks start on a cache line, so the vectorized loops on the tiles do not straddle two lines at the beginning.
+ * The address of the whole block is kept just before the aligned one, to be freed with aligned_free.
+ */
+#define MEMORY_ALIGNMENT 64
+
+//zeroed block of count items of size bytes
+void* aligned_calloc(unsigned long count, unsigned long size) {
+    char* block = calloc(count * size + MEMORY_ALIGNMENT + sizeof(void*), 1);
+    if(block == NULL) {
+        return NULL;
+    }
+    uintptr_t aligned = ((uintptr_t) (block + sizeof(void*)) + MEMORY_ALIGNMENT - 1) & ~((uintptr_t) MEMORY_ALIGNMENT - 1);
+    ((void**) aligned)[-1] = block;
+    return (void*) aligned;
 }
 
-bool with_gui(int argc, char* argv[]) {
+void aligned_free(void* pointer) {
+    if(pointer != NULL) {
+        free(((void**) pointer)[-1]);
+    }
+}
+
+//value following the option name in the arguments, NULL if the option is not given
+const char* get_argument_value(int argc, char* argv[], const char* name) {
+    for(int i = 0; i < argc - 1; i++) {
+        if(strcmp(name, argv[i]) == 0) {
+            return argv[i + 1];
+        }
+    }
+
+    return NULL;
+}
+
+bool has_argument(int argc, char* argv[], const char* name) {
     for(int i = 0; i < argc; i++) {
-        if(strcmp("-g", argv[i]) == 0) {
+        if(strcmp(name, argv[i]) == 0) {
             return true;
         }
     }
     
     return false;
 }
+
+bool with_gui(int argc, char* argv[]) {
+    return has_argument(argc, argv, "-g");
+}
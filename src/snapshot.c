@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+/* Snapshots of the matrix during the computation
+ * Every period steps, the tiles are written with a collective MPI-IO write in the file prefix_<step>.raw.
+ * The file starts with a text header of SNAPSHOT_HEADER_SIZE bytes "HEAT2D <lines> <columns> <step> <ratio> <fields>"
+ * followed by the lines of the matrix as native doubles, the fields of a case being contiguous.
+ * With a ratio r, only the cases (x, y) with x and y multiples of r are kept.
+ *
+ * The writes are non blocking and use two buffers: the computation goes on while the previous snapshot is written.
+ * No process holds more than its own tile.
+ */
+#define SNAPSHOT_HEADER_SIZE 64
+
+typedef struct snapshot_slot {
+    double* buffer;
+    MPI_File file;
+    MPI_Request request;
+    bool busy;
+} snapshot_slot;
+
+typedef struct snapshot_writer {
+    const char* prefix;
+    int period;
+    int ratio;
+    int fields;
+    coordinates size;
+    coordinates first;
+    coordinates count;
+    MPI_Datatype file_type;
+    snapshot_slot slots[2];
+    int next_slot;
+} snapshot_writer;
+
+int ceil_div(int a, int b) {
+    return (a + b - 1) / b;
+}
+
+//snapshots are enabled by -o prefix, -f gives the period (default 100) and -r the downsampling ratio (default 1)
+snapshot_writer snapshot_writer_from_arguments(int argc, char* argv[], tile my_tile) {
+    snapshot_writer writer;
+    const char* period = get_argument_value(argc, argv, "-f");
+    const char* ratio = get_argument_value(argc, argv, "-r");
+
+    writer.prefix = get_argument_value(argc, argv, "-o");
+    writer.period = (writer.prefix == NULL) ? 0 : ((period == NULL) ? 100 : atoi(period));
+    writer.ratio = (ratio == NULL) ? 1 : atoi(ratio);
+    writer.fields = my_tile.fields;
+    writer.next_slot = 0;
+    if(writer.prefix == NULL) {
+        return writer;
+    }
+    if(writer.period <= 0 || writer.ratio <= 0) {
+        if(get_my_id() == 0) {
+            fprintf(stderr, "The snapshot period and ratio should be positive.\n");
+        }
+        exit(EXIT_FAILURE);
+    }
+
+    //the cases of the tile kept by the downsampling
+    coordinates start = coordinates_init(ceil_div(my_tile.offset.x, writer.ratio), ceil_div(my_tile.offset.y, writer.ratio));
+    writer.first = coordinates_init(start.x * writer.ratio - my_tile.offset.x, start.y * writer.ratio - my_tile.offset.y);
+    writer.count = coordinates_init(
+                                    ceil_div(my_tile.offset.x + my_tile.size.x, writer.ratio) - start.x,
+                                    ceil_div(my_tile.offset.y + my_tile.size.y, writer.ratio) - start.y
+                                    );
+    coordinates end = coordinates_init(start.x + writer.count.x, start.y + writer.count.y);
+    MPI_Allreduce(&end, &writer.size, 2, MPI_INT, MPI_MAX, get_communicator());
+
+    if(writer.count.x > 0 && writer.count.y > 0) {
+        int sizes[2] = {writer.size.x, writer.size.y};
+        int subsizes[2] = {writer.count.x, writer.count.y};
+        int starts[2] = {start.x, start.y};
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, my_tile.case_type, &writer.file_type);
+    } else {
+        writer.count = coordinates_init(0, 0);
+        MPI_Type_contiguous(writer.fields, MPI_DOUBLE, &writer.file_type);
+    }
+    MPI_Type_commit(&writer.file_type);
+
+    for(int i = 0; i < 2; i++) {
+        writer.slots[i].buffer = malloc(sizeof(double) * (unsigned long) (writer.count.x * writer.count.y + 1) * (unsigned long) writer.fields);
+        writer.slots[i].busy = false;
+    }
+
+    return writer;
+}
+
+bool snapshot_writer_is_enabled(snapshot_writer writer) {
+    return writer.prefix != NULL;
+}
+
+void snapshot_slot_wait(snapshot_slot* slot) {
+    if(slot->busy) {
+        MPI_Wait(&slot->request, MPI_STATUS_IGNORE);
+        MPI_File_close(&slot->file);
+        slot->busy = false;
+    }
+}
+
+//write the tile if step is a multiple of the period
+void snapshot_writer_step(snapshot_writer* writer, tile my_tile, int step) {
+    if(!snapshot_writer_is_enabled(*writer) || step % writer->period != 0) {
+        return;
+    }
+
+    snapshot_slot* slot = &writer->slots[writer->next_slot];
+    writer->next_slot = 1 - writer->next_slot;
+    snapshot_slot_wait(slot);
+
+    for(int x = 0; x < writer->count.x; x++) {
+        for(int y = 0; y < writer->count.y; y++) {
+            for(int field = 0; field < writer->fields; field++) {
+                slot->buffer[(x * writer->count.y + y) * writer->fields + field] = tile_get_field(my_tile, field, writer->first.x + x * writer->ratio, writer->first.y + y * writer->ratio);
+            }
+        }
+    }
+
+    char file_name[1024];
+    snprintf(file_name, sizeof(file_name), "%s_%06d.raw", writer->prefix, step);
+    if(MPI_File_open(get_communicator(), file_name, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &slot->file) != MPI_SUCCESS) {
+        fprintf(stderr, "Unable to open %s\n", file_name);
+        exit(EXIT_FAILURE);
+    }
+    MPI_File_set_size(slot->file, 0);
+
+    if(get_my_id() == 0) {
+        char header[SNAPSHOT_HEADER_SIZE];
+        memset(header, ' ', SNAPSHOT_HEADER_SIZE);
+        int length = snprintf(header, SNAPSHOT_HEADER_SIZE, "HEAT2D %d %d %d %d %d", writer->size.x, writer->size.y, step, writer->ratio, writer->fields);
+        header[length] = ' ';
+        header[SNAPSHOT_HEADER_SIZE - 1] = '\n';
+        MPI_File_write_at(slot->file, 0, header, SNAPSHOT_HEADER_SIZE, MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+
+    MPI_File_set_view(slot->file, SNAPSHOT_HEADER_SIZE, MPI_DOUBLE, writer->file_type, "native", MPI_INFO_NULL);
+    MPI_File_iwrite_all(slot->file, slot->buffer, writer->count.x * writer->count.y * writer->fields, MPI_DOUBLE, &slot->request);
+    slot->busy = true;
+}
+
+//wait for the pending writes
+void snapshot_writer_destruct(snapshot_writer* writer) {
+    if(!snapshot_writer_is_enabled(*writer)) {
+        return;
+    }
+
+    for(int i = 0; i < 2; i++) {
+        snapshot_slot_wait(&writer->slots[i]);
+        free(writer->slots[i].buffer);
+    }
+    MPI_Type_free(&writer->file_type);
+}
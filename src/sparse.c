@@ -5,6 +5,11 @@
 #include <math.h>
 #include "shared.c"
 #include "gfx.c"
+#include "tile.c"
+#include "stencil.c"
+#include "ring.c"
+#include "parser.c"
+#include "query.c"
 
 /* Quelques structures utiles */
 typedef enum request_type {
@@ -49,15 +54,17 @@ typedef struct environment {
 
 
 /* Input parsing */
-environment parse_file_header() {
+environment parse_file_header(parser* parser) {
     environment data;
     coordinates matrix_size;
     
-    if(scanf("%d %d %lf %d", &matrix_size.y, &matrix_size.x, &data.p, &data.t) != 4) {
+    if(!parser_next_int(parser, &matrix_size.y) || !parser_next_int(parser, &matrix_size.x) || !parser_next_double(parser, &data.p) || !parser_next_int(parser, &data.t)) {
+        fprintf(stderr, "Bad header\n");
         exit(EXIT_FAILURE);
     }
-    data.matrix = matrix_init(matrix_size);
-    
+    data.matrix.size = matrix_size;
+    data.matrix.data = NULL;
+
     return data;
 }
 
@@ -90,6 +97,185 @@ void gui_open(environment environment) {
     gui_draw_matrix(environment.matrix);
 }
 
+/* Computation of Z^t
+ * Z^t is the matrix after t steps from a matrix with a 1 on (0, 0) and 0 elsewhere: the matrix after t steps from
+ * any initial matrix is the sum of the initial values times Z^t moved on their case.
+ * The bits of t are read from the highest one: Z^{2k} is the convolution of Z^k with itself and Z^{2k+1} is one step after.
+ */
+
+/* Convolution of the blocks of Z received by the ring allgather
+ * The terms z(a) z(m - a) are added to the case m of the tile when both cases are received. When a new block comes, the
+ * terms with a in the block and m - a received before count for them and for the symmetric terms z(m - a) z(a).
+ */
+void square_add_block(tile* to, matrix zt, ring_allgather ring, int block, coordinates offset, coordinates size) {
+    for(int ax = offset.x; ax < offset.x + size.x; ax++) {
+        for(int ay = offset.y; ay < offset.y + size.y; ay++) {
+            double a_value = zt.data[ax * zt.size.y + ay];
+            if(!(a_value < 0 || a_value > 0)) {
+                continue;
+            }
+            for(int x = 0; x < to->size.x; x++) {
+                int bx = mod(to->offset.x + x - ax, zt.size.x);
+                int line_block = ring_allgather_line_block(ring, bx);
+                const double* b_values = &zt.data[bx * zt.size.y];
+                double* out = &to->data[tile_index(*to, x, 0)];
+                if(line_block > block) {
+                    continue;
+                }
+                for(int y = 0; y < to->size.y; y++) {
+                    int by = to->offset.y + y - ay;
+                    if(by < 0) {
+                        by += zt.size.y;
+                    }
+                    int b_block = (line_block < 0) ? ring.column_blocks[by] : line_block;
+                    if(b_block == block) {
+                        out[y] += a_value * b_values[by];
+                    } else if(b_block < block) {
+                        out[y] += 2 * a_value * b_values[by];
+                    }
+                }
+            }
+        }
+    }
+}
+
+//z^k -> z^{2k}. zt is a work buffer of the size of the matrix. Collective
+void square(tiling tiling, tile* z, tile* next, matrix zt) {
+    ring_allgather ring = ring_allgather_init(tiling, *z, zt.data);
+    int block;
+    coordinates offset, size;
+
+    for(int x = 0; x < next->size.x; x++) {
+        for(int y = 0; y < next->size.y; y++) {
+            tile_set_case(next, 0, x, y);
+        }
+    }
+    while(ring_allgather_next(&ring, &block, &offset, &size)) {
+        square_add_block(next, zt, ring, block, offset, size);
+    }
+    ring_allgather_destruct(&ring);
+
+    tile tmp = *z;
+    *z = *next;
+    *next = tmp;
+}
+
+//the whole Z^t is given in zt to every process. Collective
+void compute_zt(tiling tiling, stencil_kernel kernel, int t, matrix zt) {
+    tile z = tile_init(tiling, tiling_tile_coordinates(tiling, get_my_id()));
+    tile next = tile_init(tiling, z.grid_coordinates);
+    bool started = false;
+
+    if(tile_contains(z, coordinates_init(0, 0))) {
+        tile_set_case(&z, 1, 0, 0);
+    }
+
+    for(int bit = 30; bit >= 0; bit--) {
+        if(started) {
+            square(tiling, &z, &next, zt);
+        }
+        if((t >> bit) & 1) {
+            tile_exchange_halo(&z);
+            stencil_kernel_apply(kernel, z, &next);
+            tile tmp = z;
+            z = next;
+            next = tmp;
+            started = true;
+        }
+    }
+
+    //last pass without computation to give the whole matrix
+    int block;
+    coordinates offset, size;
+    ring_allgather ring = ring_allgather_init(tiling, z, zt.data);
+    while(ring_allgather_next(&ring, &block, &offset, &size)) {}
+    ring_allgather_destruct(&ring);
+
+    tile_destruct(&z);
+    tile_destruct(&next);
+}
+
+//value of the case after t steps from the given initial values
+double value_from_zt(matrix zt, const entry* values, int count, coordinates target) {
+    double value = 0;
+    for(int i = 0; i < count; i++) {
+        value += values[i].value * matrix_get_case(zt, coordinates_init(mod(target.x - values[i].coord.x, zt.size.x), mod(target.y - values[i].coord.y, zt.size.y)));
+    }
+    return value;
+}
+
+//add the value moved on target
+void matrix_add_from_zt(matrix* to, matrix zt, coordinates target, double value) {
+    coordinates coord;
+    for(coord.x = 0; coord.x < to->size.x; coord.x++) {
+        for(coord.y = 0; coord.y < to->size.y; coord.y++) {
+            coordinates moved = coordinates_init(mod(coord.x - target.x, zt.size.x), mod(coord.y - target.y, zt.size.y));
+            matrix_set_case(to, matrix_get_case(*to, coord) + value * matrix_get_case(zt, moved), coord);
+        }
+    }
+}
+
+/* Answer of the GET requests
+ * A GET gives the value after t steps of the values set before it, so every process needs the values and answers
+ * its requests from its copy of Z^t. The input stops at the first entry on the case (-1, -1). Collective
+ */
+void answer_requests(parser* parser, matrix zt) {
+    int number_of_cpu = get_number_of_cpu();
+    int number_of_entries, number_of_values = 0, number_of_requests = 0;
+    long end = LONG_MAX;
+    long my_end = LONG_MAX;
+    coordinates end_target = coordinates_init(-1, -1);
+    MPI_Datatype entry_type;
+
+    parser_split(parser);
+    entry* entries = parse_entries(parser, &number_of_entries);
+    for(int i = 0; i < number_of_entries; i++) {
+        if(coordinates_equals(entries[i].coord, end_target) && entries[i].line < my_end) {
+            my_end = entries[i].line;
+        }
+    }
+    MPI_Allreduce(&my_end, &end, 1, MPI_LONG, MPI_MIN, get_communicator());
+
+    entry* requests = malloc(sizeof(entry) * (unsigned long) (number_of_entries + 1));
+    for(int i = 0; i < number_of_entries && entries[i].line < end; i++) {
+        if(entries[i].type == GET) {
+            requests[number_of_requests++] = entries[i];
+        } else {
+            entries[number_of_values++] = entries[i];
+        }
+    }
+
+    //the values of all the processes, in the order of the input
+    int* counts = malloc(sizeof(int) * (unsigned long) number_of_cpu);
+    MPI_Allgather(&number_of_values, 1, MPI_INT, counts, 1, MPI_INT, get_communicator());
+    int* displacements = displacements_from_counts(counts, number_of_cpu);
+    entry* values = malloc(sizeof(entry) * (unsigned long) (displacements[number_of_cpu] + 1));
+    MPI_Type_contiguous((int) sizeof(entry), MPI_BYTE, &entry_type);
+    MPI_Type_commit(&entry_type);
+    MPI_Allgatherv(entries, number_of_values, entry_type, values, counts, displacements, entry_type, get_communicator());
+    MPI_Type_free(&entry_type);
+
+    coordinates* targets = malloc(sizeof(coordinates) * (unsigned long) (number_of_requests + 1));
+    double* answers = malloc(sizeof(double) * (unsigned long) (number_of_requests + 1));
+    int number_of_previous_values = 0;
+    for(int i = 0; i < number_of_requests; i++) {
+        while(number_of_previous_values < displacements[number_of_cpu] && values[number_of_previous_values].line < requests[i].line) {
+            number_of_previous_values++;
+        }
+        targets[i] = requests[i].coord;
+        answers[i] = value_from_zt(zt, values, number_of_previous_values, requests[i].coord);
+    }
+    query_print_answers(targets, answers, number_of_requests, 1);
+
+    free(entries);
+    free(requests);
+    free(counts);
+    free(displacements);
+    free(values);
+    free(targets);
+    free(answers);
+}
+
 /* Main code */
 int main(int argc, char* argv[])
 {
@@ -98,125 +284,46 @@ int main(int argc, char* argv[])
     int my_id = get_my_id();
     environment environment;
     int number_of_cpu = get_number_of_cpu();
-    coordinates my_coordinates;
+    stencil stencil = stencil_from_arguments(argc, argv);
+    parser parser = parser_from_arguments(argc, argv);
     
-    if(my_id == 0) {
-        environment = parse_file_header();
-        if(number_of_cpu != environment.matrix.size.x * environment.matrix.size.y) {
-            fprintf(stderr, "The number of CPU is different than the size of the matrix.\n");
-            exit(EXIT_FAILURE);
-        }
+    if(my_id == 0 || parser_is_mapped(parser)) {
+        environment = parse_file_header(&parser);
     }
 
-    MPI_Bcast(&environment.p, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&environment.t, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&environment.matrix.size.x, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&environment.matrix.size.y, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    my_coordinates = get_my_cell_coordinates(environment.matrix.size);
+    MPI_Bcast(&environment.p, 1, MPI_DOUBLE, 0, get_communicator());
+    MPI_Bcast(&environment.t, 1, MPI_INT, 0, get_communicator());
+    MPI_Bcast(&environment.matrix.size.x, 1, MPI_INT, 0, get_communicator());
+    MPI_Bcast(&environment.matrix.size.y, 1, MPI_INT, 0, get_communicator());
 
     //compute Z^t
-    //We don't use here the algorithm of the question 4 but the one given at question 7
-    double zt_value = (my_id == 0);
-    for(int i = environment.t; i > 0; i /= 2) {
-        //do z^t -> z^{2t}
-        coordinates added_case;
-        double new_zt_value = 0;
-        for(added_case.x = 0; added_case.x < environment.matrix.size.x; added_case.x++) {
-            for(added_case.y = 0; added_case.y < environment.matrix.size.y; added_case.y++) {
-                double added_value = zt_value;
-                MPI_Bcast(&added_value, 1, MPI_DOUBLE, cpu_id_from_coordinates_with_mod(added_case.x, added_case.y, environment.matrix.size), MPI_COMM_WORLD);
-                double tmp_zt = move_double(
-                                            cpu_id_from_coordinates_with_mod(my_coordinates.x - added_case.x, my_coordinates.y - added_case.y, environment.matrix.size),
-                                            cpu_id_from_coordinates_with_mod(my_coordinates.x + added_case.x, my_coordinates.y + added_case.y, environment.matrix.size),
-                                            zt_value
-                                            );
-                new_zt_value += added_value * tmp_zt;
-            }
-        }
-        zt_value = new_zt_value;
-
-        //compute a step if needed
-        if(i % 2 == 1) {
-            double b = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x - 1, my_coordinates.y, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x + 1, my_coordinates.y, environment.matrix.size),
-                        zt_value
-                        );
-            double d = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y - 1, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y + 1, environment.matrix.size),
-                        zt_value
-                        );
-            double f = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y + 1, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x, my_coordinates.y - 1, environment.matrix.size),
-                        zt_value
-                        );
-            double h = move_double(
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x + 1, my_coordinates.y, environment.matrix.size),
-                        cpu_id_from_coordinates_with_mod(my_coordinates.x - 1, my_coordinates.y, environment.matrix.size),
-                        zt_value
-                        );
-        
-            zt_value = (1 - environment.p) * zt_value + environment.p * (b + d + f + h) / 4;
-        }
-    }
+    //We don't use here the algorithm of the question 4 but the one given at question 7, with tiles
+    tiling tiling = tiling_init(environment.matrix.size, number_of_cpu, stencil.radius);
+    stencil_kernel kernel = stencil_kernel_init(stencil, environment.p);
+    matrix zt = matrix_init(environment.matrix.size);
+    compute_zt(tiling, kernel, environment.t, zt);
     
-    if(my_id == 0 && with_gui(argc, argv)) {
-        gui_open(environment);
-    }
-
-    //Do parsing and output
-    double my_value = 0;
-    coordinates end_target = coordinates_init(-1, -1);
-    while(42) {
-        request_type type;
-        coordinates target;
-        double x;
-
+    if(with_gui(argc, argv)) {
         if(my_id == 0) {
-            if(with_gui(argc, argv)) {
+            environment.matrix = matrix_init(environment.matrix.size);
+            gui_open(environment);
+            while(42) {
+                coordinates target;
                 gui_draw_matrix(environment.matrix);
                 while(gfx_wait() != 1) {}
                 target.x = gfx_xpos() / GUI_SCALE_FACTOR;
                 target.y = gfx_xpos() / GUI_SCALE_FACTOR;
-                x = 1;
-                type = VALUE;
-            } else {
-                if(scanf("%d %d %d %lf", &type, &target.x, &target.y, &x) != 4) {
-                    fprintf(stderr, "Bad input\n");
-                    break;
-                }
-                if(coordinates_equals(target, end_target)) {
-                    break;
-                }
-            }
-        }
-        MPI_Bcast(&type, 1, MPI_INT, 0, MPI_COMM_WORLD);
-        MPI_Bcast(&target.x, 1, MPI_INT, 0, MPI_COMM_WORLD);
-        MPI_Bcast(&target.y, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-        if(type == GET) {
-            if(my_id == 0) {
-                 printf("Value of case (%d, %d) is %lf.\n", target.x, target.y, matrix_get_case(environment.matrix, target));
+                matrix_add_from_zt(&environment.matrix, zt, target, 1);
             }
-        } else if(type == VALUE || type == CONSTANT) {
-            MPI_Bcast(&x, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-
-            //We move the cooeficent of zt
-            //If the (0, 0) should become (target.x, target.y)
-            double tmp_zt = move_double(
-                                 cpu_id_from_coordinates_with_mod(my_coordinates.x - target.x, my_coordinates.y - target.y, environment.matrix.size),
-                                 cpu_id_from_coordinates_with_mod(my_coordinates.x + target.x, my_coordinates.y + target.y, environment.matrix.size),
-                                 zt_value
-                                 );
-            my_value += x * tmp_zt;
-
-            //We get back values
-            MPI_Gather(&my_value, 1, MPI_DOUBLE, environment.matrix.data, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
         }
+    } else {
+        answer_requests(&parser, zt);
     }
 
+    parser_destruct(&parser);
+    matrix_destruct(&zt);
+    stencil_kernel_destruct(&kernel);
+    tiling_destruct(&tiling);
     MPI_Finalize();
     return EXIT_SUCCESS;
 }
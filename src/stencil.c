@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Stencil descriptors
+ * A stencil is given by the coefficients of a discrete laplacian on a (2 radius + 1)^2 window (row major, the center is at (radius, radius)).
+ * The automaton does x <- x + p / 4 * laplacian(x), so the von Neumann stencil gives back (1 - p) x + p (b + d + f + h) / 4.
+ */
+typedef struct stencil {
+    const char* name;
+    int radius;
+    const double* laplacian;
+} stencil;
+
+static const double von_neumann_laplacian[] = {
+    0,  1, 0,
+    1, -4, 1,
+    0,  1, 0
+};
+
+//isotropic 9 points laplacian: needs the diagonal neighbours
+static const double moore_laplacian[] = {
+    1. / 6,   4. / 6, 1. / 6,
+    4. / 6, -20. / 6, 4. / 6,
+    1. / 6,   4. / 6, 1. / 6
+};
+
+//fourth order laplacian along each axis: (-1, 16, -30, 16, -1) / 12
+static const double fourth_order_laplacian[] = {
+    0,       0, -1. / 12,       0,        0,
+    0,       0, 16. / 12,       0,        0,
+    -1. / 12, 16. / 12,    -5, 16. / 12, -1. / 12,
+    0,       0, 16. / 12,       0,        0,
+    0,       0, -1. / 12,       0,        0
+};
+
+static const stencil stencils[] = {
+    {"von-neumann", 1, von_neumann_laplacian},
+    {"moore", 1, moore_laplacian},
+    {"fourth-order", 2, fourth_order_laplacian}
+};
+
+int stencil_width(stencil stencil) {
+    return 2 * stencil.radius + 1;
+}
+
+stencil stencil_from_name(const char* name) {
+    for(unsigned long i = 0; i < sizeof(stencils) / sizeof(stencils[0]); i++) {
+        if(strcmp(stencils[i].name, name) == 0) {
+            return stencils[i];
+        }
+    }
+
+    fprintf(stderr, "Unknown stencil %s\n", name);
+    exit(EXIT_FAILURE);
+}
+
+//the stencil is given by the -s option, default is the von Neumann one
+stencil stencil_from_arguments(int argc, char* argv[]) {
+    const char* name = get_argument_value(argc, argv, "-s");
+
+    return (name == NULL) ? stencils[0] : stencil_from_name(name);
+}
+
+//weights of the automaton for a given p. The result should be freed
+double* stencil_weights(stencil stencil, double p) {
+    int width = stencil_width(stencil);
+    unsigned long size = (unsigned long) (width * width);
+    double* weights = malloc(sizeof(double) * size);
+
+    for(unsigned long i = 0; i < size; i++) {
+        weights[i] = p / 4 * stencil.laplacian[i];
+    }
+    weights[stencil.radius * width + stencil.radius] += 1;
+
+    return weights;
+}
+
+
+/* Kernel of the automaton: the non zero weights of a stencil for a given p */
+typedef struct stencil_kernel {
+    int size;
+    coordinates* shifts;
+    double* weights;
+} stencil_kernel;
+
+stencil_kernel stencil_kernel_init(stencil stencil, double p) {
+    stencil_kernel kernel;
+    int width = stencil_width(stencil);
+    double* weights = stencil_weights(stencil, p);
+
+    kernel.size = 0;
+    kernel.shifts = malloc(sizeof(coordinates) * (unsigned long) (width * width));
+    kernel.weights = malloc(sizeof(double) * (unsigned long) (width * width));
+    for(int i = 0; i < width; i++) {
+        for(int j = 0; j < width; j++) {
+            double weight = weights[i * width + j];
+            if(weight < 0 || weight > 0) {
+                kernel.shifts[kernel.size] = coordinates_init(i - stencil.radius, j - stencil.radius);
+                kernel.weights[kernel.size] = weight;
+                kernel.size++;
+            }
+        }
+    }
+
+    free(weights);
+    return kernel;
+}
+
+void stencil_kernel_destruct(stencil_kernel* kernel) {
+    free(kernel->shifts);
+    free(kernel->weights);
+}
+
+//shifts of the weights in the data of the tile. Kept on the stack, so a step does not allocate anything
+void stencil_kernel_index_shifts(stencil_kernel kernel, tile tile, long* shifts) {
+    for(int k = 0; k < kernel.size; k++) {
+        shifts[k] = tile_index(tile, kernel.shifts[k].x, kernel.shifts[k].y) - tile_index(tile, 0, 0);
+    }
+}
+
+/* Same as stencil_kernel_apply_in_box for tiles with several fields
+ * The fields of a case are contiguous, so the innermost loop on the fields is vectorized.
+ */
+void stencil_kernel_apply_fields_in_box(stencil_kernel kernel, tile from, tile* to, coordinates first, coordinates size) {
+    int fields = from.fields;
+    long shifts[kernel.size];
+    stencil_kernel_index_shifts(kernel, from, shifts);
+
+    for(int x = first.x; x < first.x + size.x; x++) {
+        for(int y = first.y; y < first.y + size.y; y++) {
+            const double* in = &from.data[tile_index(from, x, y)];
+            double* out = &to->data[tile_index(*to, x, y)];
+            for(int field = 0; field < fields; field++) {
+                out[field] = 0;
+            }
+            for(int k = 0; k < kernel.size; k++) {
+                const double* neighbour = in + shifts[k];
+                double weight = kernel.weights[k];
+                for(int field = 0; field < fields; field++) {
+                    out[field] += weight * neighbour[field];
+                }
+            }
+        }
+    }
+}
+
+//one step of the automaton on the rectangle of the tile starting at first. The halo of from should be up to date
+void stencil_kernel_apply_in_box(stencil_kernel kernel, tile from, tile* to, coordinates first, coordinates size) {
+    if(from.fields > 1) {
+        stencil_kernel_apply_fields_in_box(kernel, from, to, first, size);
+        return;
+    }
+
+    long shifts[kernel.size];
+    stencil_kernel_index_shifts(kernel, from, shifts);
+
+    for(int x = first.x; x < first.x + size.x; x++) {
+        const double* in = &from.data[tile_index(from, x, 0)];
+        double* out = &to->data[tile_index(*to, x, 0)];
+        for(int y = first.y; y < first.y + size.y; y++) {
+            double value = 0;
+            for(int k = 0; k < kernel.size; k++) {
+                value += kernel.weights[k] * in[y + shifts[k]];
+            }
+            out[y] = value;
+        }
+    }
+}
+
+//one step of the automaton on the tile. The halo of from should be up to date
+void stencil_kernel_apply(stencil_kernel kernel, tile from, tile* to) {
+    stencil_kernel_apply_in_box(kernel, from, to, coordinates_init(0, 0), to->size);
+}
+
+//same as stencil_kernel_apply_in_box but the cases where fixed is not zero keep their value
+void stencil_kernel_apply_with_constants_in_box(stencil_kernel kernel, tile from, tile fixed, tile* to, coordinates first, coordinates size) {
+    long shifts[kernel.size];
+    stencil_kernel_index_shifts(kernel, from, shifts);
+
+    for(int x = first.x; x < first.x + size.x; x++) {
+        const double* in = &from.data[tile_index(from, x, 0)];
+        const double* constants = &fixed.data[tile_index(fixed, x, 0)];
+        double* out = &to->data[tile_index(*to, x, 0)];
+        for(int y = first.y; y < first.y + size.y; y++) {
+            if(constants[y] > 0) {
+                out[y] = in[y];
+                continue;
+            }
+            double value = 0;
+            for(int k = 0; k < kernel.size; k++) {
+                value += kernel.weights[k] * in[y + shifts[k]];
+            }
+            out[y] = value;
+        }
+    }
+}
@@ -0,0 +1,474 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+/* Block decomposition of the torus
+ * The torus is cut in grid_size.x * grid_size.y tiles. The tile (i, j) is owned by the process cpu_id_from_coordinates_with_mod(i, j, grid_size)
+ * and covers the lines [x_bounds[i], x_bounds[i + 1]) and the columns [y_bounds[j], y_bounds[j + 1]).
+ * With one process per cell we get back the abstract algorithm.
+ */
+typedef struct tiling {
+    coordinates matrix_size;
+    coordinates grid_size;
+    int* x_bounds;
+    int* y_bounds;
+    int halo;
+} tiling;
+
+int* tiling_uniform_bounds(int length, int parts) {
+    int* bounds = malloc(sizeof(int) * (unsigned long) (parts + 1));
+    for(int i = 0; i <= parts; i++) {
+        bounds[i] = (int) ((long) i * length / parts);
+    }
+    return bounds;
+}
+
+bool tiling_bounds_are_valid(const int* bounds, int parts, int halo) {
+    for(int i = 0; i < parts; i++) {
+        if(bounds[i + 1] - bounds[i] < halo || bounds[i + 1] <= bounds[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//true if length can be cut in parts uniform parts of at least halo lines
+bool tiling_parts_are_valid(int length, int parts, int halo) {
+    int* bounds = tiling_uniform_bounds(length, parts);
+    bool valid = tiling_bounds_are_valid(bounds, parts, halo);
+    free(bounds);
+    return valid;
+}
+
+/* The grid is the factorization of the number of processes with the smallest halo surface among the ones whose tiles
+ * are larger than the halo. The halo of a tile is about 2 * halo * (size.x / grid_size.x + size.y / grid_size.y),
+ * which is proportional to size.x * grid_size.y + size.y * grid_size.x.
+ */
+tiling tiling_init(coordinates matrix_size, int number_of_cpu, int halo) {
+    tiling tiling;
+    tiling.matrix_size = matrix_size;
+    tiling.halo = halo;
+    tiling.grid_size = coordinates_init(0, 0);
+    long best_surface = 0;
+
+    for(int x = 1; x <= number_of_cpu; x++) {
+        int y = number_of_cpu / x;
+        if(x * y != number_of_cpu || !tiling_parts_are_valid(matrix_size.x, x, halo) || !tiling_parts_are_valid(matrix_size.y, y, halo)) {
+            continue;
+        }
+        long surface = (long) matrix_size.x * y + (long) matrix_size.y * x;
+        if(tiling.grid_size.x == 0 || surface < best_surface) {
+            tiling.grid_size = coordinates_init(x, y);
+            best_surface = surface;
+        }
+    }
+
+    if(tiling.grid_size.x == 0) {
+        if(get_my_id() == 0) {
+            fprintf(stderr, "The matrix is too small to be cut in %d tiles with a halo of size %d.\n", number_of_cpu, halo);
+        }
+        exit(EXIT_FAILURE);
+    }
+    tiling.x_bounds = tiling_uniform_bounds(matrix_size.x, tiling.grid_size.x);
+    tiling.y_bounds = tiling_uniform_bounds(matrix_size.y, tiling.grid_size.y);
+
+    return tiling;
+}
+
+void tiling_destruct(tiling* tiling) {
+    free(tiling->x_bounds);
+    free(tiling->y_bounds);
+}
+
+/* Weighted strips: cut the lines [0, length) with the given costs in parts of about the same cost
+ * Each part keeps at least min_size lines.
+ */
+int* tiling_weighted_bounds(const double* costs, int length, int parts, int min_size) {
+    int* bounds = malloc(sizeof(int) * (unsigned long) (parts + 1));
+    double total = 0;
+    double prefix = 0;
+    int position = 0;
+
+    for(int i = 0; i < length; i++) {
+        total += costs[i];
+    }
+
+    bounds[0] = 0;
+    for(int i = 1; i < parts; i++) {
+        double target = total * i / parts;
+        int lowest = bounds[i - 1] + min_size;
+        int highest = length - (parts - i) * min_size;
+        while(position < highest && (position < lowest || prefix + costs[position] / 2 < target)) {
+            prefix += costs[position];
+            position++;
+        }
+        bounds[i] = position;
+    }
+    bounds[parts] = length;
+
+    return bounds;
+}
+
+//same grid with the bounds given by the costs of the lines and of the columns
+tiling tiling_from_costs(tiling model, const double* line_costs, const double* column_costs) {
+    tiling tiling = model;
+    int min_size = (model.halo > 1) ? model.halo : 1;
+
+    tiling.x_bounds = tiling_weighted_bounds(line_costs, model.matrix_size.x, model.grid_size.x, min_size);
+    tiling.y_bounds = tiling_weighted_bounds(column_costs, model.matrix_size.y, model.grid_size.y, min_size);
+    return tiling;
+}
+
+bool tiling_same_bounds(tiling a, tiling b) {
+    return memcmp(a.x_bounds, b.x_bounds, sizeof(int) * (unsigned long) (a.grid_size.x + 1)) == 0
+        && memcmp(a.y_bounds, b.y_bounds, sizeof(int) * (unsigned long) (a.grid_size.y + 1)) == 0;
+}
+
+coordinates tiling_tile_coordinates(tiling tiling, int cpu_id) {
+    return coordinates_init(cpu_id / tiling.grid_size.y, cpu_id % tiling.grid_size.y);
+}
+
+coordinates tiling_tile_offset(tiling tiling, coordinates tile_coordinates) {
+    return coordinates_init(tiling.x_bounds[tile_coordinates.x], tiling.y_bounds[tile_coordinates.y]);
+}
+
+coordinates tiling_tile_size(tiling tiling, coordinates tile_coordinates) {
+    return coordinates_init(
+                            tiling.x_bounds[tile_coordinates.x + 1] - tiling.x_bounds[tile_coordinates.x],
+                            tiling.y_bounds[tile_coordinates.y + 1] - tiling.y_bounds[tile_coordinates.y]
+                            );
+}
+
+//part of a matrix stored on one process covered by a tile
+//rectangle of a matrix stored line by line
+MPI_Datatype matrix_block_type(coordinates matrix_size, coordinates offset, coordinates size) {
+    MPI_Datatype block;
+    int sizes[2] = {matrix_size.x, matrix_size.y};
+    int subsizes[2] = {size.x, size.y};
+    int starts[2] = {offset.x, offset.y};
+
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &block);
+    MPI_Type_commit(&block);
+    return block;
+}
+
+//part of the bounds containing value
+int tiling_find_part(const int* bounds, int parts, int value) {
+    int low = 0;
+    int high = parts - 1;
+    while(low < high) {
+        int middle = (low + high + 1) / 2;
+        if(bounds[middle] <= value) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+MPI_Datatype tiling_block_type(tiling tiling, coordinates tile_coordinates) {
+    return matrix_block_type(tiling.matrix_size, tiling_tile_offset(tiling, tile_coordinates), tiling_tile_size(tiling, tile_coordinates));
+}
+
+
+/* A tile stored with its halo
+ * Local coordinates go from -halo to size + halo - 1.
+ * A tile can hold several fields advanced together: the values of the fields of a case are contiguous.
+ * The halo transfers of a tile are persistent requests set up with the tile (see tile_init_halo_requests).
+ */
+#define HALO_REQUESTS 8
+
+typedef struct tile {
+    coordinates grid_coordinates;
+    coordinates offset;
+    coordinates size;
+    int halo;
+    int fields;
+    double* data;
+    double* columns;        //halo columns to send to the left and right, and received from the left and right
+    MPI_Datatype case_type;
+    MPI_Datatype interior_type;
+    MPI_Request halo_requests[HALO_REQUESTS];
+} tile;
+
+coordinates tile_padded_size(tile tile) {
+    return coordinates_init(tile.size.x + 2 * tile.halo, tile.size.y + 2 * tile.halo);
+}
+
+//length of a halo column, with the lines of the halo in order to get the corners
+long tile_column_length(tile tile) {
+    return (long) tile_padded_size(tile).x * tile.halo * tile.fields;
+}
+
+//index in data of the first field of the case
+long tile_index(tile tile, int x, int y) {
+    return ((long) (x + tile.halo) * (tile.size.y + 2 * tile.halo) + y + tile.halo) * tile.fields;
+}
+
+/* The transfers are persistent requests on buffers allocated with the tile, so a step only starts and waits for them.
+ * The requests 0 to 3 are the receptions from up and down and the lines going down and up, the requests 4 to 7
+ * the receptions from the left and the right and the columns going right and left, as in halo_activity.
+ * The columns are copied to and from the contiguous buffers of tile->columns.
+ */
+void tile_init_halo_requests(tiling tiling, tile* tile) {
+    int h = tile->halo;
+    int line_length = (tile->size.y + 2 * h) * h;
+    int column_length = (int) tile_column_length(*tile);
+    int up = cpu_id_from_coordinates_with_mod(tile->grid_coordinates.x - 1, tile->grid_coordinates.y, tiling.grid_size);
+    int down = cpu_id_from_coordinates_with_mod(tile->grid_coordinates.x + 1, tile->grid_coordinates.y, tiling.grid_size);
+    int left = cpu_id_from_coordinates_with_mod(tile->grid_coordinates.x, tile->grid_coordinates.y - 1, tiling.grid_size);
+    int right = cpu_id_from_coordinates_with_mod(tile->grid_coordinates.x, tile->grid_coordinates.y + 1, tiling.grid_size);
+    double* columns = tile->columns;
+
+    MPI_Recv_init(&tile->data[tile_index(*tile, -h, -h)], line_length, tile->case_type, up, 1, get_communicator(), &tile->halo_requests[0]);
+    MPI_Recv_init(&tile->data[tile_index(*tile, tile->size.x, -h)], line_length, tile->case_type, down, 2, get_communicator(), &tile->halo_requests[1]);
+    MPI_Send_init(&tile->data[tile_index(*tile, tile->size.x - h, -h)], line_length, tile->case_type, down, 1, get_communicator(), &tile->halo_requests[2]);
+    MPI_Send_init(&tile->data[tile_index(*tile, 0, -h)], line_length, tile->case_type, up, 2, get_communicator(), &tile->halo_requests[3]);
+
+    MPI_Recv_init(&columns[2 * column_length], column_length, MPI_DOUBLE, left, 3, get_communicator(), &tile->halo_requests[4]);
+    MPI_Recv_init(&columns[3 * column_length], column_length, MPI_DOUBLE, right, 4, get_communicator(), &tile->halo_requests[5]);
+    MPI_Send_init(&columns[column_length], column_length, MPI_DOUBLE, right, 3, get_communicator(), &tile->halo_requests[6]);
+    MPI_Send_init(&columns[0], column_length, MPI_DOUBLE, left, 4, get_communicator(), &tile->halo_requests[7]);
+}
+
+tile tile_init_with_fields(tiling tiling, coordinates tile_coordinates, int fields) {
+    tile tile;
+    tile.grid_coordinates = tile_coordinates;
+    tile.offset = tiling_tile_offset(tiling, tile_coordinates);
+    tile.size = tiling_tile_size(tiling, tile_coordinates);
+    tile.halo = tiling.halo;
+    tile.fields = fields;
+
+    coordinates padded_size = tile_padded_size(tile);
+    tile.data = aligned_calloc((unsigned long) (padded_size.x * padded_size.y) * (unsigned long) fields, sizeof(double));
+    tile.columns = aligned_calloc(4 * (unsigned long) tile_column_length(tile), sizeof(double));
+
+    MPI_Type_contiguous(fields, MPI_DOUBLE, &tile.case_type);
+    MPI_Type_commit(&tile.case_type);
+
+    int sizes[2] = {padded_size.x, padded_size.y};
+    int subsizes[2] = {tile.size.x, tile.size.y};
+    int starts[2] = {tile.halo, tile.halo};
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, tile.case_type, &tile.interior_type);
+    MPI_Type_commit(&tile.interior_type);
+
+    tile_init_halo_requests(tiling, &tile);
+
+    return tile;
+}
+
+tile tile_init(tiling tiling, coordinates tile_coordinates) {
+    return tile_init_with_fields(tiling, tile_coordinates, 1);
+}
+
+void tile_destruct(tile* tile) {
+    for(int i = 0; i < HALO_REQUESTS; i++) {
+        MPI_Request_free(&tile->halo_requests[i]);
+    }
+    aligned_free(tile->data);
+    aligned_free(tile->columns);
+    MPI_Type_free(&tile->case_type);
+    MPI_Type_free(&tile->interior_type);
+}
+
+double tile_get_field(tile tile, int field, int x, int y) {
+    return tile.data[tile_index(tile, x, y) + field];
+}
+
+void tile_set_field(tile* tile, int field, double value, int x, int y) {
+    tile->data[tile_index(*tile, x, y) + field] = value;
+}
+
+double tile_get_case(tile tile, int x, int y) {
+    return tile.data[tile_index(tile, x, y)];
+}
+
+void tile_set_case(tile* tile, double value, int x, int y) {
+    tile->data[tile_index(*tile, x, y)] = value;
+}
+
+bool tile_contains(tile tile, coordinates coord) {
+    return coord.x >= tile.offset.x && coord.x < tile.offset.x + tile.size.x && coord.y >= tile.offset.y && coord.y < tile.offset.y + tile.size.y;
+}
+
+/* Halo exchange
+ * The lines are exchanged first, then the columns with the lines of the halo: the corners are forwarded
+ * by the vertical neighbours so there is no need of diagonal messages (see question 2).
+ * There are four transfers: the lines going down, the lines going up, the columns going right and the columns going left.
+ * A transfer can be skipped when both sides know that it only carries zeros.
+ */
+typedef struct halo_activity {
+    bool send[4];
+    bool receive[4];
+} halo_activity;
+
+halo_activity halo_activity_all() {
+    halo_activity activity;
+    for(int i = 0; i < 4; i++) {
+        activity.send[i] = true;
+        activity.receive[i] = true;
+    }
+    return activity;
+}
+
+coordinates tile_neighbour_coordinates(tiling tiling, tile tile, int dx, int dy) {
+    return coordinates_init(mod(tile.grid_coordinates.x + dx, tiling.grid_size.x), mod(tile.grid_coordinates.y + dy, tiling.grid_size.y));
+}
+
+//copy between the columns of the tile starting at y and a column buffer
+void tile_copy_column(tile* tile, int y, double* column, bool to_column) {
+    int h = tile->halo;
+    unsigned long width = sizeof(double) * (unsigned long) (h * tile->fields);
+
+    for(int x = -h; x < tile->size.x + h; x++) {
+        double* cases = &tile->data[tile_index(*tile, x, y)];
+        if(to_column) {
+            memcpy(column, cases, width);
+        } else {
+            memcpy(cases, column, width);
+        }
+        column += h * tile->fields;
+    }
+}
+
+//start the transfers of one phase which are active and wait for them
+void tile_run_halo_requests(tile* tile, int first, halo_activity activity) {
+    MPI_Request requests[4];
+    int number_of_requests = 0;
+
+    for(int i = 0; i < 2; i++) {
+        if(activity.receive[first + i]) {
+            requests[number_of_requests++] = tile->halo_requests[2 * first + i];
+        }
+    }
+    for(int i = 0; i < 2; i++) {
+        if(activity.send[first + i]) {
+            requests[number_of_requests++] = tile->halo_requests[2 * first + 2 + i];
+        }
+    }
+    MPI_Startall(number_of_requests, requests);
+    MPI_Waitall(number_of_requests, requests, MPI_STATUSES_IGNORE);
+}
+
+void tile_exchange_halo_partially(tile* tile, halo_activity activity) {
+    int h = tile->halo;
+    long column_length = tile_column_length(*tile);
+
+    tile_run_halo_requests(tile, 0, activity);
+
+    if(activity.send[3]) {
+        tile_copy_column(tile, 0, &tile->columns[0], true);
+    }
+    if(activity.send[2]) {
+        tile_copy_column(tile, tile->size.y - h, &tile->columns[column_length], true);
+    }
+    tile_run_halo_requests(tile, 2, activity);
+    if(activity.receive[2]) {
+        tile_copy_column(tile, -h, &tile->columns[2 * column_length], false);
+    }
+    if(activity.receive[3]) {
+        tile_copy_column(tile, tile->size.y, &tile->columns[3 * column_length], false);
+    }
+}
+
+void tile_exchange_halo(tile* tile) {
+    tile_exchange_halo_partially(tile, halo_activity_all());
+}
+
+/* Gather of the matrix on the process 0 */
+void tiling_gather(tiling tiling, tile my_tile, double* matrix_data) {
+    int number_of_tiles = tiling.grid_size.x * tiling.grid_size.y;
+    MPI_Request request;
+
+    MPI_Isend(my_tile.data, 1, my_tile.interior_type, 0, 0, get_communicator(), &request);
+
+    if(get_my_id() == 0) {
+        for(int i = 0; i < number_of_tiles; i++) {
+            MPI_Datatype block = tiling_block_type(tiling, tiling_tile_coordinates(tiling, i));
+            MPI_Recv(matrix_data, 1, block, i, 0, get_communicator(), MPI_STATUS_IGNORE);
+            MPI_Type_free(&block);
+        }
+    }
+
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+}
+
+
+/* Migration of a tile to the tile of the same process in another tiling of the same grid. Collective
+ * Each process sends to each other one the intersection of its old tile with their new tile.
+ */
+bool rectangle_intersection(coordinates offset_a, coordinates size_a, coordinates offset_b, coordinates size_b, coordinates* offset, coordinates* size) {
+    int x_end = (offset_a.x + size_a.x < offset_b.x + size_b.x) ? offset_a.x + size_a.x : offset_b.x + size_b.x;
+    int y_end = (offset_a.y + size_a.y < offset_b.y + size_b.y) ? offset_a.y + size_a.y : offset_b.y + size_b.y;
+
+    *offset = coordinates_init((offset_a.x > offset_b.x) ? offset_a.x : offset_b.x, (offset_a.y > offset_b.y) ? offset_a.y : offset_b.y);
+    *size = coordinates_init(x_end - offset->x, y_end - offset->y);
+    return size->x > 0 && size->y > 0;
+}
+
+void tiling_migrate(tiling from_tiling, tile from, tiling to_tiling, tile* to) {
+    int number_of_tiles = from_tiling.grid_size.x * from_tiling.grid_size.y;
+    int* send_counts = calloc((unsigned long) number_of_tiles, sizeof(int));
+    int* send_displacements = malloc(sizeof(int) * (unsigned long) (number_of_tiles + 1));
+    int* receive_counts = calloc((unsigned long) number_of_tiles, sizeof(int));
+    int* receive_displacements = malloc(sizeof(int) * (unsigned long) (number_of_tiles + 1));
+    double* send_buffer = calloc((unsigned long) (from.size.x * from.size.y), sizeof(double));
+    double* receive_buffer = malloc(sizeof(double) * (unsigned long) (to->size.x * to->size.y));
+    coordinates offset, size;
+
+    send_displacements[0] = 0;
+    for(int i = 0; i < number_of_tiles; i++) {
+        coordinates other = tiling_tile_coordinates(to_tiling, i);
+        if(rectangle_intersection(from.offset, from.size, tiling_tile_offset(to_tiling, other), tiling_tile_size(to_tiling, other), &offset, &size)) {
+            for(int x = 0; x < size.x; x++) {
+                for(int y = 0; y < size.y; y++) {
+                    send_buffer[send_displacements[i] + send_counts[i]++] = tile_get_case(from, offset.x + x - from.offset.x, offset.y + y - from.offset.y);
+                }
+            }
+        }
+        send_displacements[i + 1] = send_displacements[i] + send_counts[i];
+    }
+
+    receive_displacements[0] = 0;
+    for(int i = 0; i < number_of_tiles; i++) {
+        coordinates other = tiling_tile_coordinates(from_tiling, i);
+        if(rectangle_intersection(to->offset, to->size, tiling_tile_offset(from_tiling, other), tiling_tile_size(from_tiling, other), &offset, &size)) {
+            receive_counts[i] = size.x * size.y;
+        }
+        receive_displacements[i + 1] = receive_displacements[i] + receive_counts[i];
+    }
+
+    MPI_Alltoallv(
+                  send_buffer, send_counts, send_displacements, MPI_DOUBLE,
+                  receive_buffer, receive_counts, receive_displacements, MPI_DOUBLE,
+                  get_communicator()
+                  );
+
+    for(int i = 0; i < number_of_tiles; i++) {
+        coordinates other = tiling_tile_coordinates(from_tiling, i);
+        if(rectangle_intersection(to->offset, to->size, tiling_tile_offset(from_tiling, other), tiling_tile_size(from_tiling, other), &offset, &size)) {
+            for(int x = 0; x < size.x; x++) {
+                for(int y = 0; y < size.y; y++) {
+                    tile_set_case(to, receive_buffer[receive_displacements[i] + x * size.y + y], offset.x + x - to->offset.x, offset.y + y - to->offset.y);
+                }
+            }
+        }
+    }
+
+    free(send_counts);
+    free(send_displacements);
+    free(receive_counts);
+    free(receive_displacements);
+    free(send_buffer);
+    free(receive_buffer);
+}
+
+//replace a tile by its migration to another tiling. Collective
+void tile_migrate(tiling from_tiling, tiling to_tiling, tile* my_tile) {
+    tile migrated = tile_init(to_tiling, my_tile->grid_coordinates);
+    tiling_migrate(from_tiling, *my_tile, to_tiling, &migrated);
+    tile_destruct(my_tile);
+    *my_tile = migrated;
+}
@@ -0,0 +1,265 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+/* Quelques structures utiles */
+typedef struct coordinates3d {
+    int x;
+    int y;
+    int z;
+} coordinates3d;
+
+coordinates3d coordinates3d_init(int x, int y, int z) {
+    coordinates3d coord;
+    coord.x = x;
+    coord.y = y;
+    coord.z = z;
+    return coord;
+}
+
+int coordinates3d_get(coordinates3d coord, int axis) {
+    return (axis == 0) ? coord.x : ((axis == 1) ? coord.y : coord.z);
+}
+
+int cpu_id_from_coordinates3d_with_mod(int x, int y, int z, coordinates3d grid_size) {
+    return (mod(x, grid_size.x) * grid_size.y + mod(y, grid_size.y)) * grid_size.z + mod(z, grid_size.z);
+}
+
+
+/* Block decomposition of the 3D torus, see tile.c for the 2D one
+ * The tile (i, j, k) covers [bounds[0][i], bounds[0][i + 1]) x [bounds[1][j], bounds[1][j + 1]) x [bounds[2][k], bounds[2][k + 1]).
+ */
+typedef struct tiling3d {
+    coordinates3d matrix_size;
+    coordinates3d grid_size;
+    int* bounds[3];
+    int halo;
+} tiling3d;
+
+/* The grid is the factorization of the number of processes with the smallest halo surface, see tiling_init
+ * The faces of a tile are proportional to size.y * size.z * grid_size.x + size.x * size.z * grid_size.y + size.x * size.y * grid_size.z.
+ */
+tiling3d tiling3d_init(coordinates3d matrix_size, int number_of_cpu, int halo) {
+    tiling3d tiling;
+    tiling.matrix_size = matrix_size;
+    tiling.halo = halo;
+    tiling.grid_size = coordinates3d_init(0, 0, 0);
+    double best_surface = 0;
+
+    for(int x = 1; x <= number_of_cpu; x++) {
+        for(int y = 1; x * y <= number_of_cpu; y++) {
+            int z = number_of_cpu / (x * y);
+            if(x * y * z != number_of_cpu || !tiling_parts_are_valid(matrix_size.x, x, halo)
+               || !tiling_parts_are_valid(matrix_size.y, y, halo) || !tiling_parts_are_valid(matrix_size.z, z, halo)) {
+                continue;
+            }
+            double surface = (double) matrix_size.y * matrix_size.z * x + (double) matrix_size.x * matrix_size.z * y + (double) matrix_size.x * matrix_size.y * z;
+            if(tiling.grid_size.x == 0 || surface < best_surface) {
+                tiling.grid_size = coordinates3d_init(x, y, z);
+                best_surface = surface;
+            }
+        }
+    }
+
+    if(tiling.grid_size.x == 0) {
+        if(get_my_id() == 0) {
+            fprintf(stderr, "The matrix is too small to be cut in %d tiles with a halo of size %d.\n", number_of_cpu, halo);
+        }
+        exit(EXIT_FAILURE);
+    }
+    for(int axis = 0; axis < 3; axis++) {
+        tiling.bounds[axis] = tiling_uniform_bounds(coordinates3d_get(matrix_size, axis), coordinates3d_get(tiling.grid_size, axis));
+    }
+
+    return tiling;
+}
+
+void tiling3d_destruct(tiling3d* tiling) {
+    for(int axis = 0; axis < 3; axis++) {
+        free(tiling->bounds[axis]);
+    }
+}
+
+coordinates3d tiling3d_tile_coordinates(tiling3d tiling, int cpu_id) {
+    return coordinates3d_init(
+                              cpu_id / (tiling.grid_size.y * tiling.grid_size.z),
+                              (cpu_id / tiling.grid_size.z) % tiling.grid_size.y,
+                              cpu_id % tiling.grid_size.z
+                              );
+}
+
+coordinates3d tiling3d_tile_offset(tiling3d tiling, coordinates3d tile_coordinates) {
+    return coordinates3d_init(
+                              tiling.bounds[0][tile_coordinates.x],
+                              tiling.bounds[1][tile_coordinates.y],
+                              tiling.bounds[2][tile_coordinates.z]
+                              );
+}
+
+coordinates3d tiling3d_tile_size(tiling3d tiling, coordinates3d tile_coordinates) {
+    return coordinates3d_init(
+                              tiling.bounds[0][tile_coordinates.x + 1] - tiling.bounds[0][tile_coordinates.x],
+                              tiling.bounds[1][tile_coordinates.y + 1] - tiling.bounds[1][tile_coordinates.y],
+                              tiling.bounds[2][tile_coordinates.z + 1] - tiling.bounds[2][tile_coordinates.z]
+                              );
+}
+
+MPI_Datatype subarray3d_type(coordinates3d sizes, coordinates3d subsizes, coordinates3d starts) {
+    MPI_Datatype type;
+    int array_sizes[3] = {sizes.x, sizes.y, sizes.z};
+    int array_subsizes[3] = {subsizes.x, subsizes.y, subsizes.z};
+    int array_starts[3] = {starts.x, starts.y, starts.z};
+
+    MPI_Type_create_subarray(3, array_sizes, array_subsizes, array_starts, MPI_ORDER_C, MPI_DOUBLE, &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+//part of a matrix stored on one process covered by a tile
+MPI_Datatype tiling3d_block_type(tiling3d tiling, coordinates3d tile_coordinates) {
+    return subarray3d_type(tiling.matrix_size, tiling3d_tile_size(tiling, tile_coordinates), tiling3d_tile_offset(tiling, tile_coordinates));
+}
+
+
+/* A 3D tile stored with its halo
+ * Only the faces of the halo are exchanged, which is enough for the 7 points stencil.
+ * face_types[axis][0] and face_types[axis][1] are the low and high faces of the tile, halo_types[axis][0] and halo_types[axis][1] the low and high faces of the halo.
+ */
+typedef struct tile3d {
+    coordinates3d grid_coordinates;
+    coordinates3d offset;
+    coordinates3d size;
+    int halo;
+    double* data;
+    MPI_Datatype interior_type;
+    MPI_Datatype face_types[3][2];
+    MPI_Datatype halo_types[3][2];
+} tile3d;
+
+coordinates3d tile3d_padded_size(tile3d tile) {
+    return coordinates3d_init(tile.size.x + 2 * tile.halo, tile.size.y + 2 * tile.halo, tile.size.z + 2 * tile.halo);
+}
+
+//face of the padded tile orthogonal to axis of width halo starting at start along axis
+MPI_Datatype tile3d_face_type(tile3d tile, int axis, int start) {
+    int h = tile.halo;
+    coordinates3d subsizes = tile.size;
+    coordinates3d starts = coordinates3d_init(h, h, h);
+
+    if(axis == 0) {
+        subsizes.x = h;
+        starts.x = start;
+    } else if(axis == 1) {
+        subsizes.y = h;
+        starts.y = start;
+    } else {
+        subsizes.z = h;
+        starts.z = start;
+    }
+    return subarray3d_type(tile3d_padded_size(tile), subsizes, starts);
+}
+
+tile3d tile3d_init(tiling3d tiling, coordinates3d tile_coordinates) {
+    tile3d tile;
+    tile.grid_coordinates = tile_coordinates;
+    tile.offset = tiling3d_tile_offset(tiling, tile_coordinates);
+    tile.size = tiling3d_tile_size(tiling, tile_coordinates);
+    tile.halo = tiling.halo;
+
+    coordinates3d padded_size = tile3d_padded_size(tile);
+    tile.data = calloc((unsigned long) padded_size.x * (unsigned long) padded_size.y * (unsigned long) padded_size.z, sizeof(double));
+
+    tile.interior_type = subarray3d_type(padded_size, tile.size, coordinates3d_init(tile.halo, tile.halo, tile.halo));
+    for(int axis = 0; axis < 3; axis++) {
+        int size = coordinates3d_get(tile.size, axis);
+        tile.face_types[axis][0] = tile3d_face_type(tile, axis, tile.halo);
+        tile.face_types[axis][1] = tile3d_face_type(tile, axis, size);
+        tile.halo_types[axis][0] = tile3d_face_type(tile, axis, 0);
+        tile.halo_types[axis][1] = tile3d_face_type(tile, axis, size + tile.halo);
+    }
+
+    return tile;
+}
+
+void tile3d_destruct(tile3d* tile) {
+    free(tile->data);
+    MPI_Type_free(&tile->interior_type);
+    for(int axis = 0; axis < 3; axis++) {
+        for(int side = 0; side < 2; side++) {
+            MPI_Type_free(&tile->face_types[axis][side]);
+            MPI_Type_free(&tile->halo_types[axis][side]);
+        }
+    }
+}
+
+long tile3d_index(tile3d tile, int x, int y, int z) {
+    coordinates3d padded_size = tile3d_padded_size(tile);
+    return ((long) (x + tile.halo) * padded_size.y + y + tile.halo) * padded_size.z + z + tile.halo;
+}
+
+int tile3d_neighbour(tiling3d tiling, tile3d tile, int axis, int direction) {
+    coordinates3d coord = tile.grid_coordinates;
+    return cpu_id_from_coordinates3d_with_mod(
+                                              coord.x + (axis == 0) * direction,
+                                              coord.y + (axis == 1) * direction,
+                                              coord.z + (axis == 2) * direction,
+                                              tiling.grid_size
+                                              );
+}
+
+/* Halo exchange of the faces, directly from and to the tile thanks to the subarray types
+ * The send and receive buffers are the same array, so the transfers are non blocking ones rather than MPI_Sendrecv.
+ */
+void tile3d_exchange_halo(tiling3d tiling, tile3d* tile) {
+    MPI_Request requests[4];
+
+    for(int axis = 0; axis < 3; axis++) {
+        int low = tile3d_neighbour(tiling, *tile, axis, -1);
+        int high = tile3d_neighbour(tiling, *tile, axis, 1);
+
+        MPI_Irecv(tile->data, 1, tile->halo_types[axis][0], low, 2 * axis, get_communicator(), &requests[0]);
+        MPI_Irecv(tile->data, 1, tile->halo_types[axis][1], high, 2 * axis + 1, get_communicator(), &requests[1]);
+        MPI_Isend(tile->data, 1, tile->face_types[axis][1], high, 2 * axis, get_communicator(), &requests[2]);
+        MPI_Isend(tile->data, 1, tile->face_types[axis][0], low, 2 * axis + 1, get_communicator(), &requests[3]);
+        MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+    }
+}
+
+/* Scatter and gather of a matrix stored on the process 0 */
+void tiling3d_scatter(tiling3d tiling, double* matrix_data, tile3d* my_tile) {
+    int number_of_tiles = tiling.grid_size.x * tiling.grid_size.y * tiling.grid_size.z;
+    MPI_Request* requests = NULL;
+
+    if(get_my_id() == 0) {
+        requests = malloc(sizeof(MPI_Request) * (unsigned long) number_of_tiles);
+        for(int i = 0; i < number_of_tiles; i++) {
+            MPI_Datatype block = tiling3d_block_type(tiling, tiling3d_tile_coordinates(tiling, i));
+            MPI_Isend(matrix_data, 1, block, i, 0, get_communicator(), &requests[i]);
+            MPI_Type_free(&block);
+        }
+    }
+
+    MPI_Recv(my_tile->data, 1, my_tile->interior_type, 0, 0, get_communicator(), MPI_STATUS_IGNORE);
+
+    if(requests != NULL) {
+        MPI_Waitall(number_of_tiles, requests, MPI_STATUSES_IGNORE);
+        free(requests);
+    }
+}
+
+void tiling3d_gather(tiling3d tiling, tile3d my_tile, double* matrix_data) {
+    int number_of_tiles = tiling.grid_size.x * tiling.grid_size.y * tiling.grid_size.z;
+    MPI_Request request;
+
+    MPI_Isend(my_tile.data, 1, my_tile.interior_type, 0, 0, get_communicator(), &request);
+
+    if(get_my_id() == 0) {
+        for(int i = 0; i < number_of_tiles; i++) {
+            MPI_Datatype block = tiling3d_block_type(tiling, tiling3d_tile_coordinates(tiling, i));
+            MPI_Recv(matrix_data, 1, block, i, 0, get_communicator(), MPI_STATUS_IGNORE);
+            MPI_Type_free(&block);
+        }
+    }
+
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+}